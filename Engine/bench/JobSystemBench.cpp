@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Engine/Core/Jobs/JobSystem.h"
+
+/* Measures the per-task overhead of the job system: N empty jobs spawned from the
+ * main thread, from inside a worker, and as ParallelFor indices. Reports wall time
+ * per task and the share of jobs that were stolen from another thread's deque.
+ *
+ *     JobSystemBench [jobCount] [workerCount]
+ */
+
+namespace {
+
+    typedef std::chrono::steady_clock Clock;
+
+    void Report(const char* name, std::size_t count, Clock::duration elapsed) {
+        const Engine::JobSystem::Stats stats = Engine::JobSystem::GetStats();
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+
+        std::printf("%-22s %10zu tasks %10.1f ns/task   spawned %10llu   stolen %10llu (%5.1f%%)\n",
+                    name, count, ns / count,
+                    static_cast<unsigned long long>(stats.spawned),
+                    static_cast<unsigned long long>(stats.stolen),
+                    stats.spawned ? 100.0 * stats.stolen / stats.spawned : 0.0);
+    }
+
+    // Every job is queued on the main thread's shared deque, so workers can only steal
+    void RunFromMain(std::size_t count) {
+        Engine::JobSystem::ResetStats();
+        Engine::JobCounter counter;
+
+        const Clock::time_point start = Clock::now();
+        for (std::size_t i = 0; i < count; ++i) {
+            Engine::JobSystem::Run([]() {}, &counter);
+        }
+        Engine::JobSystem::Wait(counter);
+
+        Report("Run/Wait (main)", count, Clock::now() - start);
+    }
+
+    // Jobs are queued on one worker's own deque: it pops, the others steal
+    void RunFromWorker(std::size_t count) {
+        Engine::JobSystem::ResetStats();
+        Engine::JobCounter counter;
+
+        const Clock::time_point start = Clock::now();
+        Engine::JobSystem::Run([count, &counter]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                Engine::JobSystem::Run([]() {}, &counter);
+            }
+        }, &counter);
+        Engine::JobSystem::Wait(counter);
+
+        Report("Run/Wait (worker)", count, Clock::now() - start);
+    }
+
+    void RunParallelFor(std::size_t count) {
+        Engine::JobSystem::ResetStats();
+
+        const Clock::time_point start = Clock::now();
+        Engine::JobSystem::ParallelFor(count, [](std::size_t) {});
+
+        Report("ParallelFor", count, Clock::now() - start);
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const std::size_t workers = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                         : Engine::JobSystem::DefaultWorkerCount();
+
+    Engine::JobSystem::Init(workers);
+    std::printf("%zu workers\n", Engine::JobSystem::GetWorkerCount());
+
+    // the first pass warms up the threads and the deques' allocations
+    RunFromMain(count / 10 + 1);
+
+    RunFromMain(count);
+    RunFromWorker(count);
+    RunParallelFor(count);
+
+    Engine::JobSystem::Shutdown();
+    return 0;
+}
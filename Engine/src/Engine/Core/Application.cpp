@@ -9,6 +9,7 @@
 
 #include "Engine/Core/Input.h"
 
+#include <cassert>
 #include <functional>
 
 namespace Engine {
@@ -27,6 +28,8 @@ namespace Engine {
     }
 
     Application::~Application() {
+        // the render thread calls the derived Extract, so Stop has to run before destruction
+        assert(!m_RenderThread.joinable());
         m_Window.release();
     }
 
@@ -46,9 +49,67 @@ namespace Engine {
     }
 
     void Application::Render() {
+        ecs.WriteBuffers();
+
+        if (m_PipelinedRender) {
+            std::unique_lock<std::mutex> lock(m_RenderMutex);
+
+            // the previous frame's Extract reads the buffers the swap hands back for writing
+            m_RenderCondition.wait(lock, [this]() { return !m_FramePending; });
+            ecs.SwapBuffers();
+            m_FramePending = true;
+
+            lock.unlock();
+            m_RenderCondition.notify_all();
+        } else {
+            ecs.SwapBuffers();
+            Extract();
+        }
+
         m_Window->Update();
     }
 
+    void Application::Stop() {
+        SetPipelinedRender(false);
+    }
+
+    /* Extract gets a thread of its own rather than a job: the main thread helps run
+     * queued jobs whenever it waits on systems, and would end up extracting inline. */
+    void Application::SetPipelinedRender(bool pipelined) {
+        if (pipelined && !m_RenderThread.joinable()) {
+            m_StopRender = false;
+            m_RenderThread = std::thread(&Application::RenderLoop, this);
+        } else if (!pipelined && m_RenderThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_RenderMutex);
+                m_StopRender = true;
+            }
+            m_RenderCondition.notify_all();
+            m_RenderThread.join();
+        }
+
+        m_PipelinedRender = pipelined;
+    }
+
+    void Application::RenderLoop() {
+        std::unique_lock<std::mutex> lock(m_RenderMutex);
+
+        while (true) {
+            m_RenderCondition.wait(lock, [this]() { return m_FramePending || m_StopRender; });
+
+            // a frame swapped in before Stop is still extracted
+            if (!m_FramePending)
+                return;
+
+            lock.unlock();
+            Extract();
+            lock.lock();
+
+            m_FramePending = false;
+            m_RenderCondition.notify_all();
+        }
+    }
+
     void Application::OnEvent(Event &e) {
         EventDispatcher dispatcher(e);
         dispatcher.Dispatch<WindowCloseEvent>(BIND_EVENT_FN(Application::OnWindowClose));
@@ -1,7 +1,10 @@
 #ifndef GRAPHICSTEMPLATE_APPLICATION_H
 #define GRAPHICSTEMPLATE_APPLICATION_H
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <GLFW/glfw3.h>
 
 #include "Events/ApplicationEvent.h"
@@ -14,12 +17,23 @@ namespace Engine {
     class Application {
     public:
         Application();
-        ~Application();
+        virtual ~Application();
 
         bool Init();
         void Start();
         void Update(float dt);
         void Render();
+        // Joins the render thread; call it before the application is destroyed
+        void Stop();
+
+        /* Reads the double-buffered components (ECS::GetReadBuffer) to prepare a frame.
+         * With a pipelined render it runs on a render thread while the next tick
+         * simulates, so it must not touch anything else in the ECS. */
+        virtual void Extract() {}
+
+        // Runs Extract on a render thread alongside the simulation instead of after it
+        void SetPipelinedRender(bool pipelined);
+        bool IsPipelinedRender() const { return m_PipelinedRender; }
 
         void OnEvent(Event& e);
         bool OnWindowClose(WindowCloseEvent& e);
@@ -36,6 +50,16 @@ namespace Engine {
         std::unique_ptr<Window> m_Window;
         bool m_IsRunning = true;
 
+        void RenderLoop();
+
+        bool m_PipelinedRender = false;
+        std::thread m_RenderThread;
+        std::mutex m_RenderMutex;
+        std::condition_variable m_RenderCondition;
+        // A swapped frame waiting for (or in) Extract
+        bool m_FramePending = false;
+        bool m_StopRender = false;
+
         static Application* s_Instance;
     };
 
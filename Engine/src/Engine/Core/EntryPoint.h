@@ -4,15 +4,21 @@
 #include <stdio.h>
 
 #include "Application.h"
+#include "Engine/Core/Jobs/JobSystem.h"
 
 extern Engine::Application *Engine::CreateApplication();
 
 int main(int argc, char** argv) {
     Engine::Log::Init();
+    Engine::JobSystem::Init();
     Engine::Application* game = Engine::CreateApplication();
 
     // Initialize()
-    if (!game->Init()) return 1;
+    if (!game->Init()) {
+        delete game;
+        Engine::JobSystem::Shutdown();
+        return 1;
+    }
 
     // Start()
     game->Start();
@@ -44,7 +50,11 @@ int main(int argc, char** argv) {
         game->Render();
     }
 
+    // Stop()
+    game->Stop();
+
     delete game;
+    Engine::JobSystem::Shutdown();
     return 0;
 }
 
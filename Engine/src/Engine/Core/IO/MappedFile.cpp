@@ -0,0 +1,87 @@
+#include "MappedFile.h"
+
+#include <fstream>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ENG_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Engine {
+
+    MappedFile::MappedFile()
+    :
+            m_Data(nullptr),
+            m_Size(0),
+            m_Mapped(false) { }
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    bool MappedFile::Open(const std::string& path) {
+        Close();
+
+#ifdef ENG_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* data = ::mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (data != MAP_FAILED) {
+            m_Data = static_cast<unsigned char*>(data);
+            m_Size = info.st_size;
+            m_Mapped = true;
+            return true;
+        }
+#endif
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        std::streamsize size = file.tellg();
+        if (size <= 0)
+            return false;
+
+        file.seekg(0);
+        m_Data = static_cast<unsigned char*>(::operator new(size, std::align_val_t(PAGE_ALIGNMENT)));
+        m_Size = size;
+
+        if (!file.read(reinterpret_cast<char*>(m_Data), size)) {
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (!m_Data)
+            return;
+
+#ifdef ENG_HAS_MMAP
+        if (m_Mapped)
+            ::munmap(m_Data, m_Size);
+        else
+#endif
+            ::operator delete(m_Data, std::align_val_t(PAGE_ALIGNMENT));
+
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Mapped = false;
+    }
+
+}
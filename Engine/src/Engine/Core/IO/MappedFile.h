@@ -0,0 +1,36 @@
+#ifndef GRAPHICSTEMPLATE_MAPPEDFILE_H
+#define GRAPHICSTEMPLATE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace Engine {
+
+    /* A whole file mapped into memory copy-on-write: the contents can be modified in
+     * place but changes never reach the file. The mapping is page aligned. Platforms
+     * without mmap read the file into a page aligned buffer instead. */
+    class MappedFile {
+    public:
+        static constexpr std::size_t PAGE_ALIGNMENT = 4096;
+
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string& path);
+        void Close();
+
+        inline unsigned char* GetData() const { return m_Data; }
+        inline std::size_t GetSize() const { return m_Size; }
+
+    private:
+        unsigned char* m_Data;
+        std::size_t m_Size;
+        bool m_Mapped;
+    };
+
+}
+
+#endif //GRAPHICSTEMPLATE_MAPPEDFILE_H
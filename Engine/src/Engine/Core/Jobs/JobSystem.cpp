@@ -0,0 +1,228 @@
+#include "JobSystem.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace Engine {
+
+    namespace {
+
+        struct QueuedJob {
+            JobSystem::Job job;
+            JobCounter* counter;
+        };
+
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<QueuedJob> jobs;
+        };
+
+        // One deque per worker, plus a shared one at the end for every other thread
+        std::vector<std::unique_ptr<WorkQueue>> s_Queues;
+        std::vector<std::thread> s_Workers;
+
+        std::atomic<std::size_t> s_QueuedJobs(0);
+        std::atomic<std::size_t> s_SleepingWorkers(0);
+        std::atomic<bool> s_Running(false);
+        std::mutex s_SleepMutex;
+        std::condition_variable s_SleepCondition;
+
+        std::atomic<std::uint64_t> s_Spawned(0);
+        std::atomic<std::uint64_t> s_Stolen(0);
+        std::atomic<std::uint64_t> s_Completed(0);
+
+        thread_local std::size_t t_QueueIndex = SIZE_MAX;
+
+        // Joins the workers at exit if Shutdown was never called, e.g. on an early return
+        struct ShutdownAtExit {
+            ~ShutdownAtExit() {
+                if (!s_Workers.empty())
+                    JobSystem::Shutdown();
+            }
+        } s_ShutdownAtExit;
+
+        std::size_t GetQueueIndex() {
+            return t_QueueIndex == SIZE_MAX ? s_Queues.size() - 1 : t_QueueIndex;
+        }
+
+    }
+
+    std::size_t JobSystem::s_WorkerCount = 0;
+
+    void JobSystem::Init(std::size_t workerCount) {
+        if (s_Running)
+            Shutdown();
+
+        s_WorkerCount = workerCount;
+        s_Running = true;
+
+        for (std::size_t i = 0; i < workerCount + 1; ++i) {
+            s_Queues.push_back(std::make_unique<WorkQueue>());
+        }
+
+        for (std::size_t i = 0; i < workerCount; ++i) {
+            s_Workers.emplace_back(&JobSystem::WorkerLoop, i);
+        }
+    }
+
+    void JobSystem::Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(s_SleepMutex);
+            s_Running = false;
+        }
+        s_SleepCondition.notify_all();
+
+        for (std::thread& worker : s_Workers) {
+            worker.join();
+        }
+
+        // whatever is still queued runs here so no counter is left waiting
+        s_WorkerCount = 0;
+        while (TryRunJob()) { }
+
+        s_Workers.clear();
+        s_Queues.clear();
+    }
+
+    std::size_t JobSystem::DefaultWorkerCount() {
+        return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    void JobSystem::Run(Job job, JobCounter* counter) {
+        if (counter)
+            counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+
+        Push(std::move(job), counter);
+    }
+
+    void JobSystem::RunAfter(JobCounter& dependency, Job job, JobCounter* counter) {
+        if (counter)
+            counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(dependency.m_Mutex);
+            if (!dependency.IsDone()) {
+                dependency.m_Continuations.push_back({std::move(job), counter});
+                return;
+            }
+        }
+
+        Push(std::move(job), counter);
+    }
+
+    void JobSystem::Wait(JobCounter& counter) {
+        while (!counter.IsDone()) {
+            if (!TryRunJob())
+                std::this_thread::yield();
+        }
+    }
+
+    JobSystem::Stats JobSystem::GetStats() {
+        return { s_Spawned.load(), s_Stolen.load(), s_Completed.load() };
+    }
+
+    void JobSystem::ResetStats() {
+        s_Spawned = 0;
+        s_Stolen = 0;
+        s_Completed = 0;
+    }
+
+    void JobSystem::WorkerLoop(std::size_t index) {
+        t_QueueIndex = index;
+
+        while (s_Running) {
+            if (TryRunJob())
+                continue;
+
+            std::unique_lock<std::mutex> lock(s_SleepMutex);
+            ++s_SleepingWorkers;
+            s_SleepCondition.wait(lock, []() { return !s_Running || s_QueuedJobs > 0; });
+            --s_SleepingWorkers;
+        }
+    }
+
+    bool JobSystem::TryRunJob() {
+        if (s_Queues.empty())
+            return false;
+
+        const std::size_t self = GetQueueIndex();
+        QueuedJob queued;
+        bool found = false;
+
+        {
+            WorkQueue& queue = *s_Queues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty()) {
+                queued = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                found = true;
+            }
+        }
+
+        for (std::size_t i = 1; !found && i < s_Queues.size(); ++i) {
+            WorkQueue& victim = *s_Queues[(self + i) % s_Queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                queued = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                found = true;
+                s_Stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (!found)
+            return false;
+
+        --s_QueuedJobs;
+        queued.job();
+        s_Completed.fetch_add(1, std::memory_order_relaxed);
+
+        Finish(queued.counter);
+        return true;
+    }
+
+    void JobSystem::Push(Job job, JobCounter* counter) {
+        s_Spawned.fetch_add(1, std::memory_order_relaxed);
+
+        if (s_WorkerCount == 0) {
+            job();
+            s_Completed.fetch_add(1, std::memory_order_relaxed);
+            Finish(counter);
+            return;
+        }
+
+        // counted before it is visible so a thief can never take s_QueuedJobs below zero
+        ++s_QueuedJobs;
+
+        {
+            WorkQueue& queue = *s_Queues[GetQueueIndex()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back({std::move(job), counter});
+        }
+
+        // a worker registers as sleeping before it checks s_QueuedJobs, so no wakeup is lost
+        if (s_SleepingWorkers > 0) {
+            std::lock_guard<std::mutex> lock(s_SleepMutex);
+            s_SleepCondition.notify_one();
+        }
+    }
+
+    void JobSystem::Finish(JobCounter* counter) {
+        if (!counter)
+            return;
+
+        std::vector<JobCounter::Continuation> continuations;
+        {
+            std::lock_guard<std::mutex> lock(counter->m_Mutex);
+            if (counter->m_Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                continuations.swap(counter->m_Continuations);
+        }
+
+        for (JobCounter::Continuation& continuation : continuations) {
+            Push(std::move(continuation.job), continuation.counter);
+        }
+    }
+
+}
@@ -0,0 +1,111 @@
+#ifndef GRAPHICSTEMPLATE_JOBSYSTEM_H
+#define GRAPHICSTEMPLATE_JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Engine {
+
+    /* Tracks outstanding jobs. Jobs started with a counter increment it when queued and
+     * decrement it when done; jobs queued with RunAfter start once it reaches zero. */
+    class JobCounter {
+    public:
+        JobCounter() : m_Count(0) { }
+
+        ~JobCounter() {
+            // the last decrement may still be releasing the lock
+            std::lock_guard<std::mutex> lock(m_Mutex);
+        }
+
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool IsDone() const { return m_Count.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+
+        struct Continuation {
+            std::function<void()> job;
+            JobCounter* counter;
+        };
+
+        std::atomic<std::size_t> m_Count;
+        std::mutex m_Mutex;
+        std::vector<Continuation> m_Continuations;
+    };
+
+    /* Work-stealing job system. Every worker owns a deque: it pushes and pops its own
+     * jobs at the back and steals from the front of the others when it runs dry.
+     * Threads that are not workers (the main thread) share one extra deque and help
+     * run jobs while they Wait. Without workers, jobs run inline on the caller. */
+    class JobSystem {
+    public:
+        typedef std::function<void()> Job;
+
+        struct Stats {
+            std::uint64_t spawned;
+            std::uint64_t stolen;
+            std::uint64_t completed;
+        };
+
+        static void Init(std::size_t workerCount = DefaultWorkerCount());
+        static void Shutdown();
+
+        static std::size_t DefaultWorkerCount();
+        inline static std::size_t GetWorkerCount() { return s_WorkerCount; }
+
+        static void Run(Job job, JobCounter* counter = nullptr);
+        static void RunAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+
+        // Runs queued jobs on the calling thread until counter reaches zero
+        static void Wait(JobCounter& counter);
+
+        static Stats GetStats();
+        static void ResetStats();
+
+        /* Calls fn(i) for every i in [0, count) on the workers and the caller. Indices come
+         * from a shared cursor so threads that finish early keep pulling work. */
+        template<typename Fn>
+        static void ParallelFor(const std::size_t count, Fn&& fn) {
+            if (count < 2 || s_WorkerCount == 0) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    fn(i);
+                }
+                return;
+            }
+
+            std::atomic<std::size_t> next(0);
+            JobCounter counter;
+
+            auto drain = [&]() {
+                for (std::size_t i = next++; i < count; i = next++) {
+                    fn(i);
+                }
+            };
+
+            const std::size_t helpers = std::min(s_WorkerCount, count - 1);
+            for (std::size_t h = 0; h < helpers; ++h) {
+                Run(drain, &counter);
+            }
+
+            drain();
+            Wait(counter);
+        }
+
+    private:
+        static void WorkerLoop(std::size_t index);
+        static bool TryRunJob();
+        static void Push(Job job, JobCounter* counter);
+        static void Finish(JobCounter* counter);
+
+        static std::size_t s_WorkerCount;
+    };
+
+}
+
+#endif //GRAPHICSTEMPLATE_JOBSYSTEM_H
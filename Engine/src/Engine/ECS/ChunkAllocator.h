@@ -0,0 +1,180 @@
+#ifndef GRAPHICSTEMPLATE_CHUNKALLOCATOR_H
+#define GRAPHICSTEMPLATE_CHUNKALLOCATOR_H
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "EcsTypes.h"
+
+namespace Engine {
+
+    struct ChunkAllocatorStats {
+        std::uint64_t allocations;
+        std::uint64_t frees;
+        // allocations served by a block some archetype freed earlier
+        std::uint64_t recycled;
+        std::size_t bytesInUse;
+        // bytes held from the system heap, in use or waiting in a pool
+        std::size_t bytesReserved;
+    };
+
+    /* Source of the memory blocks archetype chunks live in. The ECS asks for blocks of
+     * Archetype::chunkBytes bytes aligned to Archetype::chunkAlignment and hands every
+     * block back with the same size and alignment. */
+    class ChunkAllocator {
+    public:
+        virtual ~ChunkAllocator() {}
+
+        virtual ComponentData Allocate(std::size_t size, std::size_t alignment) = 0;
+        virtual void Free(ComponentData data, std::size_t size, std::size_t alignment) = 0;
+
+        // Gives memory that is not in use back to the system, if the allocator keeps any
+        virtual void Trim() {}
+
+        virtual ChunkAllocatorStats GetStats() const = 0;
+    };
+
+    /* Default allocator. Blocks of up to CHUNK_SIZE bytes are carved out of pages of
+     * BLOCKS_PER_PAGE blocks and recycled through one free list, so every archetype
+     * reuses what any other archetype released. Pages are only returned by Trim, once
+     * all of their blocks are free. Larger blocks go straight to the heap. */
+    class PooledChunkAllocator : public ChunkAllocator {
+    public:
+        static constexpr std::size_t BLOCKS_PER_PAGE = 16;
+        static constexpr std::size_t PAGE_BYTES = BLOCKS_PER_PAGE * CHUNK_SIZE;
+
+        PooledChunkAllocator()
+        :
+                m_NextBlock(nullptr),
+                m_PageEnd(nullptr),
+                m_Stats() { }
+
+        ~PooledChunkAllocator() {
+            for (ComponentData page : m_Pages) {
+                ::operator delete(page, std::align_val_t(PAGE_BYTES));
+            }
+        }
+
+        PooledChunkAllocator(const PooledChunkAllocator&) = delete;
+        PooledChunkAllocator& operator=(const PooledChunkAllocator&) = delete;
+
+        virtual ComponentData Allocate(std::size_t size, std::size_t alignment) override {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ++m_Stats.allocations;
+
+            if (!IsPooled(size, alignment)) {
+                m_Stats.bytesInUse += size;
+                m_Stats.bytesReserved += size;
+                return static_cast<ComponentData>(::operator new(size, std::align_val_t(alignment)));
+            }
+
+            m_Stats.bytesInUse += CHUNK_SIZE;
+
+            if (!m_FreeBlocks.empty()) {
+                ++m_Stats.recycled;
+                ComponentData block = m_FreeBlocks.back();
+                m_FreeBlocks.pop_back();
+                return block;
+            }
+
+            if (m_NextBlock == m_PageEnd)
+                AllocatePage();
+
+            ComponentData block = m_NextBlock;
+            m_NextBlock += CHUNK_SIZE;
+            return block;
+        }
+
+        virtual void Free(ComponentData data, std::size_t size, std::size_t alignment) override {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ++m_Stats.frees;
+
+            if (!IsPooled(size, alignment)) {
+                m_Stats.bytesInUse -= size;
+                m_Stats.bytesReserved -= size;
+                ::operator delete(data, std::align_val_t(alignment));
+                return;
+            }
+
+            m_FreeBlocks.push_back(data);
+            m_Stats.bytesInUse -= CHUNK_SIZE;
+        }
+
+        virtual void Trim() override {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            // pages are PAGE_BYTES aligned, so a block's page is found by masking its address
+            std::unordered_map<ComponentData, std::size_t> freePerPage;
+            for (ComponentData block : m_FreeBlocks) {
+                ++freePerPage[GetPage(block)];
+            }
+
+            // blocks of the current page that were never handed out count as free too
+            ComponentData currentPage = m_Pages.empty() ? nullptr : m_Pages.back();
+            if (currentPage)
+                freePerPage[currentPage] += (m_PageEnd - m_NextBlock) / CHUNK_SIZE;
+
+            std::vector<ComponentData> blocks;
+            for (ComponentData block : m_FreeBlocks) {
+                if (freePerPage[GetPage(block)] != BLOCKS_PER_PAGE)
+                    blocks.push_back(block);
+            }
+            m_FreeBlocks.swap(blocks);
+
+            std::vector<ComponentData> pages;
+            for (ComponentData page : m_Pages) {
+                if (freePerPage[page] == BLOCKS_PER_PAGE) {
+                    ::operator delete(page, std::align_val_t(PAGE_BYTES));
+                    m_Stats.bytesReserved -= PAGE_BYTES;
+                } else {
+                    pages.push_back(page);
+                }
+            }
+            m_Pages.swap(pages);
+
+            if (currentPage && (m_Pages.empty() || m_Pages.back() != currentPage)) {
+                m_NextBlock = nullptr;
+                m_PageEnd = nullptr;
+            }
+        }
+
+        virtual ChunkAllocatorStats GetStats() const override {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Stats;
+        }
+
+    private:
+        static bool IsPooled(std::size_t size, std::size_t alignment) {
+            return size <= CHUNK_SIZE && alignment <= CHUNK_SIZE;
+        }
+
+        static ComponentData GetPage(ComponentData block) {
+            return reinterpret_cast<ComponentData>(reinterpret_cast<std::uintptr_t>(block)
+                                                   & ~static_cast<std::uintptr_t>(PAGE_BYTES - 1));
+        }
+
+        void AllocatePage() {
+            ComponentData page = static_cast<ComponentData>(
+                    ::operator new(PAGE_BYTES, std::align_val_t(PAGE_BYTES)));
+            m_Pages.push_back(page);
+            m_Stats.bytesReserved += PAGE_BYTES;
+
+            m_NextBlock = page;
+            m_PageEnd = page + PAGE_BYTES;
+        }
+
+        mutable std::mutex m_Mutex;
+        std::vector<ComponentData> m_Pages;
+        std::vector<ComponentData> m_FreeBlocks;
+        // Blocks of the newest page that were never handed out
+        ComponentData m_NextBlock;
+        ComponentData m_PageEnd;
+        ChunkAllocatorStats m_Stats;
+    };
+
+}
+
+#endif //GRAPHICSTEMPLATE_CHUNKALLOCATOR_H
@@ -0,0 +1,141 @@
+#ifndef GRAPHICSTEMPLATE_COMMANDBUFFER_H
+#define GRAPHICSTEMPLATE_COMMANDBUFFER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "EcsTypes.h"
+#include "Component.h"
+
+namespace Engine {
+
+    class ECS;
+
+    /* Records structural changes (create/destroy/add/remove) so they can be made while
+     * systems are iterating archetype columns. Nothing touches the archetypes until
+     * ECS::Playback applies the buffer at a sync point. Recording is thread-safe so
+     * systems running in parallel can share one buffer. */
+    class CommandBuffer {
+    public:
+        explicit CommandBuffer(ECS& ecs)
+        :
+                m_Ecs(ecs),
+                m_CurrentPage(0),
+                m_PageUsed(0) { }
+
+        ~CommandBuffer() {
+            Clear();
+        }
+
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        /* The handle is usable right away by the other commands in this buffer; the
+         * entity itself only exists once the buffer is played back. */
+        EntityID CreateEntity();
+
+        void DestroyEntity(const EntityID& entityId) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Commands.push_back({CommandType::Destroy, entityId, 0, nullptr, nullptr});
+        }
+
+        template<class C, typename... Args>
+        void AddComponent(const EntityID& entityId, Args&&... args) {
+            static const Component<C> component;
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            ComponentData payload = nullptr;
+            if constexpr (!IsTagComponent<C>::value) {
+                payload = Allocate(sizeof(C), alignof(C));
+                new (payload) C(std::forward<Args>(args)...);
+            }
+
+            m_Commands.push_back({CommandType::Add, entityId,
+                                  Component<C>::GetTypeID(), &component, payload});
+        }
+
+        template<class C>
+        void RemoveComponent(const EntityID& entityId) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Commands.push_back({CommandType::Remove, entityId,
+                                  Component<C>::GetTypeID(), nullptr, nullptr});
+        }
+
+        bool IsEmpty() const {
+            return m_Commands.empty();
+        }
+
+        // Drops every recorded command, destroying component values that were never applied
+        void Clear() {
+            for (Command& command : m_Commands) {
+                if (command.payload)
+                    command.component->Destroy(command.payload, 1);
+            }
+
+            m_Commands.clear();
+            m_CurrentPage = 0;
+            m_PageUsed = 0;
+        }
+
+    private:
+        friend class ECS;
+
+        static constexpr std::size_t PAGE_SIZE = 4096;
+
+        enum class CommandType : std::uint8_t {
+            Destroy,
+            Add,
+            Remove
+        };
+
+        struct Command {
+            CommandType type;
+            EntityID entity;
+            ComponentTypeID componentId;
+            const ComponentBase* component;
+            ComponentData payload;
+        };
+
+        struct Page {
+            std::unique_ptr<unsigned char[]> data;
+            std::size_t size;
+        };
+
+        // Component values live in pages that are never reallocated, so they need no relocation
+        ComponentData Allocate(std::size_t size, std::size_t alignment) {
+            while (m_CurrentPage < m_Pages.size()) {
+                Page& page = m_Pages[m_CurrentPage];
+                void* ptr = page.data.get() + m_PageUsed;
+                std::size_t space = page.size - m_PageUsed;
+
+                if (std::align(alignment, size, ptr, space)) {
+                    m_PageUsed = page.size - space + size;
+                    return static_cast<ComponentData>(ptr);
+                }
+
+                ++m_CurrentPage;
+                m_PageUsed = 0;
+            }
+
+            Page page;
+            page.size = std::max(PAGE_SIZE, size + alignment);
+            page.data = std::make_unique<unsigned char[]>(page.size);
+            m_Pages.push_back(std::move(page));
+
+            return Allocate(size, alignment);
+        }
+
+        ECS& m_Ecs;
+        std::mutex m_Mutex;
+        std::vector<Command> m_Commands;
+        std::vector<Page> m_Pages;
+        std::size_t m_CurrentPage;
+        std::size_t m_PageUsed;
+    };
+
+}
+
+#endif //GRAPHICSTEMPLATE_COMMANDBUFFER_H
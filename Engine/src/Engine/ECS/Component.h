@@ -2,12 +2,46 @@
 #define GRAPHICSTEMPLATE_COMPONENT_H
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <type_traits>
 #include "EcsTypes.h"
+#include "TypeHash.h"
 
 namespace Engine {
 
+    /* Components whose bytes can be moved with memcpy and the source simply forgotten.
+     * Specialize to std::true_type for types that are safe to relocate this way even
+     * though they are not trivially copyable. */
+    template<class C>
+    struct IsTriviallyRelocatable : std::bool_constant<std::is_trivially_copyable_v<C> &&
+                                                       std::is_trivially_destructible_v<C>> { };
+
+    /* Tag components carry no data, only archetype membership. They get no column,
+     * are never constructed per entity and reach systems as GetTagInstance, a single
+     * object rather than an array (nullptr where an Optional tag is absent). */
+    template<class C>
+    struct IsTagComponent : std::bool_constant<std::is_empty_v<C>> { };
+
+    // Tags have no storage, so every entity shares one instance of the tag
+    template<class C>
+    C* GetTagInstance() {
+        static C tag;
+        return &tag;
+    }
+
+    /* Identity of a component type in archetypes, queries, snapshots and world files: by
+     * default a hash of the type's name, so it is the same in every run and module built
+     * by one compiler. Specialize to pin the id of a type, e.g. to keep loading saved
+     * data after renaming it:
+     *
+     *     template<> struct ComponentTypeHash<Game::Transform>
+     *         : std::integral_constant<TypeHash, HashFNV1a("Transform")> { };
+     */
+    template<class C>
+    struct ComponentTypeHash : std::integral_constant<TypeHash, GetTypeHash<C>()> { };
+
     class ComponentBase {
     public:
         virtual ~ComponentBase() {}
@@ -16,12 +50,78 @@ namespace Engine {
         virtual void MoveData(unsigned char* src, unsigned char* dst) const = 0;
         virtual void CreateData(unsigned char* data) const = 0;
 
-        virtual std::size_t GetSize() const = 0;
+        virtual void DestroyRange(unsigned char* data, std::size_t count) const = 0;
+        virtual void RelocateRange(unsigned char* src, unsigned char* dst, std::size_t count) const = 0;
+
+        std::size_t GetSize() const { return m_Size; }
+        std::size_t GetAlignment() const { return m_Alignment; }
+        ComponentTypeID GetTypeID() const { return m_TypeId; }
+        // Dense index of the type in this process, for array lookups
+        IDType GetTypeIndex() const { return m_TypeIndex; }
+
+        bool IsTriviallyRelocatable() const { return m_TriviallyRelocatable; }
+        bool IsTriviallyDestructible() const { return m_TriviallyDestructible; }
+        // Values can be saved and restored as raw bytes
+        bool IsTriviallyCopyable() const { return m_TriviallyCopyable; }
+        bool IsTag() const { return m_Tag; }
+
+        // Moves count elements into uninitialized dst and ends the lifetime of the sources
+        void Relocate(unsigned char* src, unsigned char* dst, std::size_t count) const {
+            if (m_TriviallyRelocatable)
+                std::memcpy(dst, src, count * m_Size);
+            else
+                RelocateRange(src, dst, count);
+        }
+
+        void Destroy(unsigned char* data, std::size_t count) const {
+            if (!m_TriviallyDestructible)
+                DestroyRange(data, count);
+        }
+
+    protected:
+        ComponentBase(std::size_t size,
+                      std::size_t alignment,
+                      ComponentTypeID typeId,
+                      IDType typeIndex,
+                      bool triviallyRelocatable,
+                      bool triviallyDestructible,
+                      bool triviallyCopyable,
+                      bool tag)
+        :
+                m_Size(size),
+                m_Alignment(alignment),
+                m_TypeId(typeId),
+                m_TypeIndex(typeIndex),
+                m_TriviallyRelocatable(triviallyRelocatable),
+                m_TriviallyDestructible(triviallyDestructible),
+                m_TriviallyCopyable(triviallyCopyable),
+                m_Tag(tag) { }
+
+    private:
+        std::size_t m_Size;
+        std::size_t m_Alignment;
+        ComponentTypeID m_TypeId;
+        IDType m_TypeIndex;
+        bool m_TriviallyRelocatable;
+        bool m_TriviallyDestructible;
+        bool m_TriviallyCopyable;
+        bool m_Tag;
     };
 
     template<class C>
     class Component : public ComponentBase {
     public:
+        Component()
+        :
+                ComponentBase(IsTagComponent<C>::value ? 0 : sizeof(C),
+                              alignof(C),
+                              GetTypeID(),
+                              GetTypeIndex(),
+                              Engine::IsTriviallyRelocatable<C>::value || IsTagComponent<C>::value,
+                              std::is_trivially_destructible_v<C> || IsTagComponent<C>::value,
+                              std::is_trivially_copyable_v<C> || IsTagComponent<C>::value,
+                              IsTagComponent<C>::value) { }
+
         virtual void DestroyData(unsigned char* data) const override {
             C* dataLoc = std::launder(reinterpret_cast<C*>(data));
             dataLoc->~C();
@@ -35,11 +135,21 @@ namespace Engine {
             new (&data[0]) C();
         }
 
-        virtual std::size_t GetSize() const override {
-            return sizeof(C);
+        virtual void DestroyRange(unsigned char* data, std::size_t count) const override {
+            std::destroy_n(std::launder(reinterpret_cast<C*>(data)), count);
+        }
+
+        virtual void RelocateRange(unsigned char* src, unsigned char* dst, std::size_t count) const override {
+            C* from = std::launder(reinterpret_cast<C*>(src));
+            std::uninitialized_move_n(from, count, reinterpret_cast<C*>(dst));
+            std::destroy_n(from, count);
+        }
+
+        static constexpr ComponentTypeID GetTypeID() {
+            return ComponentTypeHash<C>::value;
         }
 
-        static ComponentTypeID GetTypeID() {
+        static IDType GetTypeIndex() {
             return TypeIdGenerator<ComponentBase>::GetNewID<C>();
         }
     };
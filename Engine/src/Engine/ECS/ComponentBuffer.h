@@ -0,0 +1,80 @@
+#ifndef GRAPHICSTEMPLATE_COMPONENTBUFFER_H
+#define GRAPHICSTEMPLATE_COMPONENTBUFFER_H
+
+#include <span>
+#include <vector>
+
+#include "EcsTypes.h"
+
+namespace Engine {
+
+    struct Query;
+
+    // One tick's copy of a double-buffered component, in no particular entity order
+    template<class C>
+    struct BufferedView {
+        std::span<const EntityID> entities;
+        std::span<const C> values;
+    };
+
+    /* Two copies of every value of one component type: the write buffer the simulation
+     * fills at the end of a tick and the read buffer holding the previous tick, which
+     * another thread can read while the next tick runs. */
+    class ComponentBufferBase {
+    public:
+        explicit ComponentBufferBase(Query* query)
+        :
+                m_Query(query),
+                m_ReadIndex(0) { }
+
+        virtual ~ComponentBufferBase() {}
+
+        // Sizes the write buffer for count entities and returns where their ids go
+        EntityID* ResizeWrite(std::size_t count) {
+            std::vector<EntityID>& entityIds = m_EntityIds[m_ReadIndex ^ 1];
+            entityIds.resize(count);
+            ResizeValues(m_ReadIndex ^ 1, count);
+            return entityIds.data();
+        }
+
+        virtual unsigned char* GetWriteValues() = 0;
+
+        void Swap() {
+            m_ReadIndex ^= 1;
+        }
+
+        inline Query* GetQuery() const { return m_Query; }
+
+    protected:
+        virtual void ResizeValues(std::size_t index, std::size_t count) = 0;
+
+        Query* m_Query;
+        std::vector<EntityID> m_EntityIds[2];
+        std::size_t m_ReadIndex;
+    };
+
+    template<class C>
+    class ComponentBuffer : public ComponentBufferBase {
+    public:
+        explicit ComponentBuffer(Query* query) : ComponentBufferBase(query) { }
+
+        virtual unsigned char* GetWriteValues() override {
+            return reinterpret_cast<unsigned char*>(m_Values[m_ReadIndex ^ 1].data());
+        }
+
+        BufferedView<C> GetRead() const {
+            return {m_EntityIds[m_ReadIndex], m_Values[m_ReadIndex]};
+        }
+
+    protected:
+        virtual void ResizeValues(std::size_t index, std::size_t count) override {
+            m_Values[index].resize(count);
+        }
+
+    private:
+        std::vector<C> m_Values[2];
+    };
+
+}
+
+#endif //GRAPHICSTEMPLATE_COMPONENTBUFFER_H
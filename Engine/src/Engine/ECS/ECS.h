@@ -4,22 +4,198 @@
 /* --- Reference --- */
 /* https://indiegamedev.net/2020/05/19/an-entity-component-system-with-data-locality-in-cpp/ */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 
 #include "Engine/Core/Logger/Log.h"
+#include "Engine/Core/Jobs/JobSystem.h"
+#include "Engine/Core/IO/MappedFile.h"
 
 #include "EcsTypes.h"
+#include "ChunkAllocator.h"
 #include "Component.h"
+#include "CommandBuffer.h"
+#include "ComponentBuffer.h"
 
 
 namespace Engine {
 
+    /* System parameter for an ECS resource: System<Position, Res<const Gravity>> gets a
+     * const Gravity* (nullptr while unset) next to its component columns. */
+    template<class T>
+    struct Res { };
+
+    /* Component parameters that also filter chunks: System<Changed<const Position>> only
+     * visits chunks whose Position column was written (or added) since its last run,
+     * System<Added<Position>> only those that received new Position values. */
+    template<class T>
+    struct Changed { };
+
+    template<class T>
+    struct Added { };
+
+    /* Archetype filters, resolved once when an archetype is matched. With<T> requires T
+     * without accessing it, Without<T> excludes archetypes that have T, and Optional<T>
+     * passes a T* that is nullptr for archetypes lacking T. With and Without add no
+     * parameter to the callback. */
+    template<class T>
+    struct With { };
+
+    template<class T>
+    struct Without { };
+
+    template<class T>
+    struct Optional { };
+
+    // Splits a System<Cs...> parameter into its accessed type and how it is used
+    template<class T>
+    struct SystemParam
+    {
+        typedef T Value;
+        static constexpr bool isResource = false;
+        static constexpr bool changedOnly = false;
+        static constexpr bool addedOnly = false;
+        static constexpr bool isRequired = true;
+        static constexpr bool isExcluded = false;
+        static constexpr bool hasAccess = true;
+    };
+
+    template<class T>
+    struct SystemParam<Res<T>> : SystemParam<T>
+    {
+        static constexpr bool isResource = true;
+        static constexpr bool isRequired = false;
+    };
+
+    template<class T>
+    struct SystemParam<Changed<T>> : SystemParam<T>
+    {
+        static constexpr bool changedOnly = true;
+    };
+
+    template<class T>
+    struct SystemParam<Added<T>> : SystemParam<T>
+    {
+        static constexpr bool addedOnly = true;
+    };
+
+    template<class T>
+    struct SystemParam<With<T>> : SystemParam<T>
+    {
+        static constexpr bool hasAccess = false;
+    };
+
+    template<class T>
+    struct SystemParam<Without<T>> : SystemParam<T>
+    {
+        static constexpr bool isRequired = false;
+        static constexpr bool isExcluded = true;
+        static constexpr bool hasAccess = false;
+    };
+
+    template<class T>
+    struct SystemParam<Optional<T>> : SystemParam<T>
+    {
+        static constexpr bool isRequired = false;
+    };
+
+    // The callback arguments a parameter contributes, and the callback type they add up to
+    template<class T>
+    using SystemArgs = std::conditional_t<SystemParam<T>::hasAccess,
+                                          std::tuple<typename SystemParam<T>::Value*>,
+                                          std::tuple<>>;
+
+    template<class Args>
+    struct SystemFunc;
+
+    template<class... Args>
+    struct SystemFunc<std::tuple<Args...>>
+    {
+        typedef std::function<void(const float, std::span<const EntityID>, Args...)> Type;
+    };
+
+    /* Per-entity argument for a parameter in the ForEach form: a reference for components
+     * every matched entity has, otherwise a pointer (nullptr where the component is absent,
+     * the shared instance for tags and the resource itself for Res<T>). */
+    template<class T>
+    using EntityArg = std::conditional_t<SystemParam<T>::isRequired &&
+                                         !IsTagComponent<std::remove_const_t<typename SystemParam<T>::Value>>::value,
+                                         typename SystemParam<T>::Value&,
+                                         typename SystemParam<T>::Value*>;
+
+    template<class T>
+    EntityArg<T> GetEntityArg(typename SystemParam<T>::Value* column, const std::size_t i)
+    {
+        if constexpr(SystemParam<T>::isResource ||
+                     IsTagComponent<std::remove_const_t<typename SystemParam<T>::Value>>::value)
+            return column;
+        else if constexpr(std::is_reference_v<EntityArg<T>>)
+            return column[i];
+        else
+            return column ? column + i : nullptr;
+    }
+
+    // The parameters that are passed to callbacks, in order
+    template<class T>
+    using SystemTerms = std::conditional_t<SystemParam<T>::hasAccess, std::tuple<T>, std::tuple<>>;
+
+    /* Turns a per-entity callable fn(elapsed, EntityID, EntityArg<Cs>...) into the chunk
+     * callback, so the loop over a chunk's rows is compiled together with fn. */
+    template<class Fn, class Terms>
+    struct ForEachAdapter;
+
+    template<class Fn, class... Ts>
+    struct ForEachAdapter<Fn, std::tuple<Ts...>>
+    {
+        Fn fn;
+
+        void operator()(const float elapsedMilliseconds,
+                        std::span<const EntityID> entities,
+                        typename SystemParam<Ts>::Value*... columns)
+        {
+            for(std::size_t i = 0; i < entities.size(); ++i)
+            {
+                fn(elapsedMilliseconds, entities[i], GetEntityArg<Ts>(columns, i)...);
+            }
+        }
+    };
+
     class SystemBase {
     public:
+        SystemBase() : m_RunTick(0), m_LastRunTick(0) {}
         virtual ~SystemBase() {}
         virtual ArcheTypeID GetKey() const = 0;
-        virtual void DoAction(const float elapsedTime, Archetype* archetype) = 0;
+        // Sorted ids of the components matched archetypes must not have
+        virtual ArcheTypeID GetExcludes() const = 0;
+        // Sorted ids of the components whose columns are passed only when present
+        virtual ArcheTypeID GetOptionals() const = 0;
+        // Sorted ids of the components the system only reads / also writes
+        virtual ArcheTypeID GetReads() const = 0;
+        virtual ArcheTypeID GetWrites() const = 0;
+        // columns are the query's resolved columns for archetype, see Query::GetColumns
+        virtual void DoAction(const float elapsedTime,
+                              Archetype* archetype,
+                              const std::size_t* columns) = 0;
+
+    protected:
+        friend class ECS;
+
+        // Set by the ECS around each run: the tick this run writes with, and the previous one
+        ChangeTick m_RunTick;
+        ChangeTick m_LastRunTick;
     };
 
     class ECS {
@@ -34,455 +210,2064 @@ namespace Engine {
             std::size_t index;
         };
 
-        typedef std::unordered_map<EntityID, Record> EntityArchetypeMap;
+        /* One slot per entity index. A slot's version is bumped when its entity is
+         * released, which invalidates every handle still pointing at it. Free slots
+         * are chained through nextFree starting at m_FreeSlot. */
+        struct EntitySlot
+        {
+            Record record;
+            std::uint32_t version;
+            std::uint32_t nextFree;
+        };
+
+        typedef std::vector<EntitySlot> EntitySlotArray;
+
+        static constexpr std::uint32_t NO_FREE_SLOT = UINT32_MAX;
 
         typedef std::vector<Archetype*> ArchetypesArray;
 
-        typedef std::unordered_map<std::uint8_t,std::vector<std::shared_ptr<SystemBase>>>
+        typedef std::unordered_map<ArcheTypeID, Archetype*, ArcheTypeIDHash>
+                ArchetypeIndexMap;
+
+        // Queries are identified by their (key, exclude, optional) sets
+        typedef std::tuple<ArcheTypeID, ArcheTypeID, ArcheTypeID> QueryID;
+
+        struct QueryIDHash
+        {
+            std::size_t operator()(const QueryID& id) const {
+                ArcheTypeIDHash hash;
+                return (hash(std::get<0>(id)) * 31 + hash(std::get<1>(id))) * 31 + hash(std::get<2>(id));
+            }
+        };
+
+        typedef std::unordered_map<QueryID, Query*, QueryIDHash>
+                QueryMap;
+
+        /* Systems of a layer form a DAG: a system depends on every earlier system of the
+         * layer whose component access conflicts with its own (a write against a read
+         * or write of the same component). Independent systems may run concurrently. */
+        struct SystemEntry
+        {
+            std::shared_ptr<SystemBase> system;
+            Query* query;
+            ArcheTypeID reads;
+            ArcheTypeID writes;
+            std::vector<std::size_t> dependents;
+            std::size_t dependencyCount;
+        };
+
+        typedef std::unordered_map<std::uint8_t,std::vector<SystemEntry>>
                 SystemsArrayMap;
 
+        // Saves and loads the values of a component that is not trivially copyable
+        struct ComponentSerializer
+        {
+            std::function<void(const unsigned char*, std::vector<unsigned char>&)> save;
+            std::function<void(const unsigned char*&, const unsigned char*, unsigned char*)> load;
+        };
+
+        typedef std::unordered_map<ComponentTypeID, ComponentSerializer>
+                ComponentSerializerMap;
+
+        typedef std::unordered_map<ComponentTypeID, std::unique_ptr<ComponentBufferBase>>
+                ComponentBufferMap;
+
+        struct WorldFile
+        {
+            std::unique_ptr<MappedFile> file;
+            std::size_t adoptedChunks;
+        };
+
+        // An archetype table entry of a world file, with its columns sorted by type id
+        struct WorldFileArchetype
+        {
+            ArcheTypeID type;
+            std::vector<std::size_t> columnOffsets;
+            std::size_t entityCount;
+            std::size_t chunkCapacity;
+            std::size_t chunkBytes;
+            std::size_t stride;
+            std::size_t dataOffset;
+            std::size_t serializedOffset;
+            std::size_t serializedBytes;
+        };
+
+        static constexpr std::uint32_t SNAPSHOT_MAGIC = 0x53534345; // "ECSS"
+        static constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+
+        static constexpr std::uint32_t WORLD_FILE_MAGIC = 0x57534345; // "ECSW"
+        static constexpr std::uint32_t WORLD_FILE_VERSION = 2;
+
     public:
 
-        ECS()
+        /* How archetype storage grows and shrinks. An archetype that runs out of room
+         * allocates max(minChunks, chunks * growthFactor) chunks at once, and freeing rows
+         * keeps up to spareChunks empty chunks around for the next spawn. */
+        struct GrowthPolicy
+        {
+            std::size_t minChunks;
+            float growthFactor;
+            std::size_t spareChunks;
+        };
+
+        // Chunks come from allocator, or from a PooledChunkAllocator of this ECS's own by default
+        explicit ECS(std::shared_ptr<ChunkAllocator> allocator = nullptr)
         :
-                m_EntityIdCounter(1) { }
+                m_Allocator(allocator ? allocator : std::make_shared<PooledChunkAllocator>()),
+                m_FreeSlot(NO_FREE_SLOT),
+                m_ReservedSlots(0),
+                m_GrowthPolicy({1, 0.0f, 1}),
+                m_ChangeTick(0),
+                m_Commands(*this) {
+            m_EmptyArchetype = GetArchetype(ArcheTypeID());
+        }
 
         ~ECS() {
             for (Archetype* archetype : m_Archetypes) {
-                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
-                    const ComponentBase* const comp = m_ComponentMap[archetype->type[i]];
-                    const std::size_t& dataSize = comp->GetSize();
-                    for (std::size_t e = 0; e < archetype->entityIds.size(); ++e) {
-                        comp->DestroyData(&archetype->componentData[i][e*dataSize]);
+                for (Chunk& chunk : archetype->chunks) {
+                    for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                        archetype->components[i]->Destroy(archetype->GetColumn(chunk, i), chunk.count);
                     }
 
-                    delete [] archetype->componentData[i];
+                    FreeChunkData(archetype, chunk);
                 }
 
                 delete archetype;
             }
+            for (QueryMap::value_type& q : m_Queries) {
+                delete q.second;
+            }
             for (ComponentTypeIDBaseMap::value_type& p : m_ComponentMap) {
                 delete p.second;
             }
         }
 
         EntityID GetNewID() {
-            return m_EntityIdCounter++;
+            AddReservedSlots();
+
+            std::uint32_t index;
+
+            if (m_FreeSlot != NO_FREE_SLOT) {
+                index = m_FreeSlot;
+                m_FreeSlot = m_Entities[index].nextFree;
+            } else {
+                if (m_Entities.size() == NO_FREE_SLOT) {
+                    throw std::runtime_error("Out of Entity Slots!");
+                }
+
+                index = static_cast<std::uint32_t>(m_Entities.size());
+
+                EntitySlot slot;
+                slot.version = 1;
+                slot.nextFree = NO_FREE_SLOT;
+                m_Entities.push_back(slot);
+            }
+
+            EntitySlot& slot = m_Entities[index];
+            slot.record.archetype = nullptr;
+            slot.record.index = 0;
+
+            return MakeEntityID(index, slot.version);
+        }
+
+        /* GetNewID for command buffers, which may record while other threads read the
+         * entity table: a free slot is only unlinked from the free list and a new one is
+         * only counted, so the table is never reallocated. Counted slots are appended by
+         * the next GetNewID or Playback; until then their handles are not alive. */
+        EntityID ReserveID() {
+            std::lock_guard<std::mutex> lock(m_ReserveMutex);
+
+            if (m_FreeSlot != NO_FREE_SLOT) {
+                const std::uint32_t index = m_FreeSlot;
+                m_FreeSlot = m_Entities[index].nextFree;
+                return MakeEntityID(index, m_Entities[index].version);
+            }
+
+            if (m_Entities.size() + m_ReservedSlots >= NO_FREE_SLOT) {
+                throw std::runtime_error("Out of Entity Slots!");
+            }
+
+            return MakeEntityID(static_cast<std::uint32_t>(m_Entities.size() + m_ReservedSlots++), 1);
+        }
+
+        bool IsAlive(const EntityID& entityId) const {
+            std::uint32_t index = GetEntityIndex(entityId);
+
+            // released slots have already moved on to a version no handle carries
+            return index < m_Entities.size() &&
+                   m_Entities[index].version == GetEntityVersion(entityId);
         }
 
         template<class C>
         void RegisterComponent() {
             ComponentTypeID componentTypeId = Component<C>::GetTypeID();
+            IDType componentTypeIndex = Component<C>::GetTypeIndex();
 
-            if (m_ComponentMap.contains(componentTypeId))
+            ComponentTypeIDBaseMap::const_iterator registered = m_ComponentMap.find(componentTypeId);
+            if (registered != m_ComponentMap.end()) {
+                // two types whose names hash alike need a ComponentTypeHash specialization
+                if (registered->second->GetTypeIndex() != componentTypeIndex) {
+                    throw std::runtime_error("Component Type ID Collision!");
+                }
                 return;
+            }
+
+            ComponentBase* component = new Component<C>;
+            m_ComponentMap.emplace(componentTypeId, component);
+
+            if (m_ComponentsByIndex.size() <= static_cast<std::size_t>(componentTypeIndex))
+                m_ComponentsByIndex.resize(componentTypeIndex + 1, nullptr);
+            m_ComponentsByIndex[componentTypeIndex] = component;
+        }
+
+        template<class C>
+        bool IsComponentRegistered() const {
+            std::size_t componentTypeIndex = Component<C>::GetTypeIndex();
+
+            return componentTypeIndex < m_ComponentsByIndex.size() &&
+                   m_ComponentsByIndex[componentTypeIndex];
+        }
+
+        void RegisterSystem(const std::uint8_t& layer, std::shared_ptr<SystemBase> system) {
+            std::vector<SystemEntry>& systems = m_Systems[layer];
+
+            SystemEntry entry;
+            entry.system = system;
+            entry.query = GetQuery(system->GetKey(), system->GetExcludes(), system->GetOptionals());
+            entry.reads = system->GetReads();
+            entry.writes = system->GetWrites();
+            entry.dependencyCount = 0;
+
+            for (std::size_t i = 0; i < systems.size(); ++i) {
+                if (Intersects(entry.writes, systems[i].writes) ||
+                    Intersects(entry.writes, systems[i].reads) ||
+                    Intersects(entry.reads, systems[i].writes)) {
+                    systems[i].dependents.push_back(systems.size());
+                    ++entry.dependencyCount;
+                }
+            }
+
+            systems.push_back(entry);
+        }
+
+        /* Returns the shared query for archetypes with every component of key and none of
+         * exclude, creating and matching it once. Columns of key and optional components
+         * are resolved as archetypes match, so iteration never searches for them. */
+        Query* GetQuery(ArcheTypeID key,
+                        ArcheTypeID exclude = ArcheTypeID(),
+                        ArcheTypeID optional = ArcheTypeID()) {
+            std::sort(key.begin(), key.end());
+            std::sort(exclude.begin(), exclude.end());
+            std::sort(optional.begin(), optional.end());
+
+            QueryID queryId(key, exclude, optional);
+            QueryMap::iterator existing = m_Queries.find(queryId);
+            if (existing != m_Queries.end())
+                return existing->second;
+
+            Query* query = new Query;
+            query->key = key;
+            query->exclude = exclude;
+            std::set_union(key.begin(), key.end(), optional.begin(), optional.end(),
+                           std::back_inserter(query->columnIds));
+
+            for (Archetype* archetype : m_Archetypes) {
+                if (Matches(query, archetype->type))
+                    AddToQuery(query, archetype);
+            }
+
+            m_Queries.emplace(queryId, query);
+            return query;
+        }
+
+        void RegisterEntity(const EntityID entityId) {
+            Record* record = GetRecord(entityId);
+            if (!record) {
+                throw std::runtime_error("Entity Not Alive!");
+            }
+
+            record->archetype = nullptr;
+            record->index = 0;
+        }
+
+        /* Runs a layer's systems, in parallel where their component access allows it.
+         * Structural changes must go through GetCommandBuffer() while systems run. */
+        void RunSystems(const std::uint8_t& layer, const float elapsedMilliseconds) {
+            std::vector<SystemEntry>& systems = m_Systems[layer];
+
+            if(systems.size() < 2 || JobSystem::GetWorkerCount() == 0)
+            {
+                for(const SystemEntry& entry : systems)
+                {
+                    RunSystem(entry, elapsedMilliseconds);
+                }
+            }
+            else
+            {
+                const std::size_t count = systems.size();
+                std::unique_ptr<std::atomic<std::size_t>[]> pending(new std::atomic<std::size_t>[count]);
+                JobCounter layerCounter;
+
+                // dependents are queued before a system's job finishes, so the counter only drains at the end
+                std::function<void(std::size_t)> run = [&](std::size_t i)
+                {
+                    RunSystem(systems[i], elapsedMilliseconds);
+
+                    for(const std::size_t& dependent : systems[i].dependents)
+                    {
+                        if(--pending[dependent] == 0)
+                            JobSystem::Run([&run, dependent]() { run(dependent); }, &layerCounter);
+                    }
+                };
+
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    pending[i] = systems[i].dependencyCount;
+                }
+
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    if(systems[i].dependencyCount == 0)
+                        JobSystem::Run([&run, i]() { run(i); }, &layerCounter);
+                }
+
+                JobSystem::Wait(layerCounter);
+            }
+
+            // sync point for structural changes the systems recorded
+            Playback(m_Commands);
+        }
+
+        void SetGrowthPolicy(const GrowthPolicy& policy) {
+            m_GrowthPolicy = policy;
+        }
+
+        const GrowthPolicy& GetGrowthPolicy() const {
+            return m_GrowthPolicy;
+        }
+
+        /* Makes room for n entities in the Cs... archetype up front. The chunks stay
+         * allocated, even when empty, until ShrinkToFit. */
+        template<class... Cs>
+        void Reserve(const std::size_t n) {
+            Archetype* archetype = GetArchetypeOf<Cs...>();
+            std::size_t chunks = (n + archetype->chunkCapacity - 1) / archetype->chunkCapacity;
+
+            while (archetype->chunks.size() < chunks) {
+                AllocateChunk(archetype);
+            }
+
+            archetype->reservedChunks = std::max(archetype->reservedChunks, chunks);
+        }
+
+        // Makes sure count more rows fit in the archetype without allocating another chunk
+        void ReserveRows(Archetype* archetype, std::size_t count) {
+            std::size_t needed = archetype->entityCount + count;
+            while (archetype->chunks.size() * archetype->chunkCapacity < needed) {
+                AllocateChunk(archetype);
+            }
+        }
+
+        // Frees every empty chunk, including reserved and spare ones, e.g. after a level unload
+        void ShrinkToFit() {
+            for (Archetype* archetype : m_Archetypes) {
+                archetype->reservedChunks = 0;
+
+                std::size_t used = GetUsedChunks(archetype);
+                while (archetype->chunks.size() > used) {
+                    FreeChunkData(archetype, archetype->chunks.back());
+                    archetype->chunks.pop_back();
+                }
+
+                archetype->chunks.shrink_to_fit();
+            }
+
+            m_Allocator->Trim();
+        }
+
+        ChunkAllocator& GetAllocator() {
+            return *m_Allocator;
+        }
+
+        /* Lets C be saved in snapshots although it is not trivially copyable. save appends
+         * a value's bytes to the blob, load reads them back from [cursor, end), advancing
+         * the cursor, and should throw on input that ends early. */
+        template<class C>
+        void RegisterSerializer(std::function<void(const C&, std::vector<unsigned char>&)> save,
+                                std::function<C(const unsigned char*&, const unsigned char*)> load) {
+            ComponentSerializer serializer;
+            serializer.save = [save](const unsigned char* data, std::vector<unsigned char>& out) {
+                save(*std::launder(reinterpret_cast<const C*>(data)), out);
+            };
+            serializer.load = [load](const unsigned char*& cursor, const unsigned char* end, unsigned char* data) {
+                new (data) C(load(cursor, end));
+            };
+
+            m_Serializers[Component<C>::GetTypeID()] = serializer;
+        }
+
+        /* Writes the entity table and every archetype's entity ids and columns into one
+         * blob. Trivially copyable columns are copied as raw bytes, a chunk at a time;
+         * other components need a registered serializer. Resources, systems and pending
+         * commands are not part of a snapshot. Raw bytes and type ids tie snapshots to
+         * builds made by the same compiler for the same platform. */
+        std::vector<unsigned char> Snapshot() const {
+            std::vector<unsigned char> blob;
+
+            WriteValue(blob, SNAPSHOT_MAGIC);
+            WriteValue(blob, SNAPSHOT_VERSION);
+
+            WriteEntitySlots(blob);
+
+            std::uint32_t archetypeCount = 0;
+            for (const Archetype* archetype : m_Archetypes) {
+                if (archetype->entityCount > 0)
+                    ++archetypeCount;
+            }
+            WriteValue(blob, archetypeCount);
+
+            for (const Archetype* archetype : m_Archetypes) {
+                if (archetype->entityCount == 0)
+                    continue;
+
+                WriteValue(blob, static_cast<std::uint32_t>(archetype->type.size()));
+                for (const ComponentTypeID& compTypeId : archetype->type) {
+                    WriteValue(blob, compTypeId);
+                }
+                WriteValue(blob, static_cast<std::uint64_t>(archetype->entityCount));
+
+                const std::size_t usedChunks = GetUsedChunks(archetype);
+                for (std::size_t c = 0; c < usedChunks; ++c) {
+                    const Chunk& chunk = archetype->chunks[c];
+                    WriteBytes(blob, archetype->GetEntityIds(chunk), chunk.count * sizeof(EntityID));
+                }
+
+                const std::vector<const ComponentSerializer*> serializers = GetSerializers(archetype);
+                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                    const ComponentBase* comp = archetype->components[i];
+                    const ComponentSerializer* serializer = serializers[i];
+                    if (comp->IsTag())
+                        continue;
+
+                    for (std::size_t c = 0; c < usedChunks; ++c) {
+                        const Chunk& chunk = archetype->chunks[c];
+                        const ComponentData column = archetype->GetColumn(chunk, i);
+
+                        if (!serializer) {
+                            WriteBytes(blob, column, chunk.count * comp->GetSize());
+                            continue;
+                        }
+
+                        for (std::size_t row = 0; row < chunk.count; ++row) {
+                            serializer->save(column + row * comp->GetSize(), blob);
+                        }
+                    }
+                }
+            }
+
+            return blob;
+        }
+
+        /* Replaces every entity with the ones in a Snapshot blob. Archetypes and queries
+         * are kept, so registered systems carry on; pending commands are dropped and all
+         * restored columns count as added. A blob from another format throws before
+         * anything changes; a corrupt one throws and leaves no entities, with every handle
+         * issued before gone stale. */
+        void Restore(std::span<const unsigned char> blob) {
+            const unsigned char* cursor = blob.data();
+            const unsigned char* const end = blob.data() + blob.size();
+
+            if (ReadValue<std::uint32_t>(cursor, end) != SNAPSHOT_MAGIC ||
+                ReadValue<std::uint32_t>(cursor, end) != SNAPSHOT_VERSION) {
+                throw std::runtime_error("Unsupported Snapshot!");
+            }
+
+            m_Commands.Clear();
+            m_ReservedSlots = 0;
+            ClearEntities();
+
+            try {
+                ReadEntitySlots(cursor, end, m_Entities, m_FreeSlot);
+
+                const std::uint32_t archetypeCount = ReadValue<std::uint32_t>(cursor, end);
+                for (std::uint32_t a = 0; a < archetypeCount; ++a) {
+                    const std::uint32_t typeCount = ReadValue<std::uint32_t>(cursor, end);
+                    if (typeCount > static_cast<std::size_t>(end - cursor) / sizeof(ComponentTypeID)) {
+                        throw std::runtime_error("Corrupt Snapshot!");
+                    }
+
+                    ArcheTypeID archetypeId(typeCount);
+                    for (ComponentTypeID& compTypeId : archetypeId) {
+                        compTypeId = ReadValue<ComponentTypeID>(cursor, end);
+                        if (!m_ComponentMap.contains(compTypeId)) {
+                            throw std::runtime_error("Component Not Registered!");
+                        }
+                    }
+
+                    Archetype* archetype = GetArchetype(archetypeId);
+                    const std::vector<const ComponentSerializer*> serializers = GetSerializers(archetype);
+
+                    const std::size_t entityCount = ReadValue<std::uint64_t>(cursor, end);
+                    if (entityCount > static_cast<std::size_t>(end - cursor) / sizeof(EntityID)) {
+                        throw std::runtime_error("Corrupt Snapshot!");
+                    }
+
+                    // chunks are filled in order, all full but the last, like rows are appended
+                    ReserveRows(archetype, entityCount);
+                    for (std::size_t row = 0; row < entityCount; row += archetype->chunkCapacity) {
+                        const Chunk& chunk = archetype->chunks[row / archetype->chunkCapacity];
+                        const std::size_t count = std::min(archetype->chunkCapacity, entityCount - row);
+                        ReadBytes(cursor, end, archetype->GetEntityIds(chunk), count * sizeof(EntityID));
+                    }
+
+                    LoadRows(archetype, entityCount,
+                             [&](std::size_t i, std::size_t, ComponentData data, std::size_t count,
+                                 std::size_t& constructed) {
+                        const std::size_t size = archetype->components[i]->GetSize();
+
+                        if (!serializers[i]) {
+                            ReadBytes(cursor, end, data, count * size);
+                            constructed += count;
+                            return;
+                        }
+
+                        for (std::size_t row = 0; row < count; ++row) {
+                            LoadValue(*serializers[i], cursor, end, data + row * size, constructed);
+                        }
+                    });
+
+                    IndexLoadedRows(archetype);
+                }
+            } catch (...) {
+                ClearEntities();
+                ReleaseEntitySlots();
+                throw;
+            }
+        }
+
+        /* Saves every entity to a world file laid out like the archetypes in memory: a
+         * header, a component type table keyed by type id, the entity table, an
+         * archetype table and then each archetype's chunks, page aligned. Components that
+         * are not trivially copyable go through their registered serializers instead:
+         * their columns are left zeroed in the chunks and each archetype's values follow
+         * all chunks. The file uses this machine's byte order. */
+        void SaveWorld(const std::string& path) const {
+            std::vector<const Archetype*> archetypes;
+            std::vector<ComponentTypeID> types;
+            std::unordered_map<ComponentTypeID, std::uint32_t> typeIndex;
+            std::vector<std::vector<unsigned char>> serialized;
+
+            for (const Archetype* archetype : m_Archetypes) {
+                if (archetype->entityCount == 0)
+                    continue;
+
+                archetypes.push_back(archetype);
+                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                    if (typeIndex.emplace(archetype->type[i], types.size()).second)
+                        types.push_back(archetype->type[i]);
+                }
+
+                // values in row order, one column after the other
+                const std::vector<const ComponentSerializer*> serializers = GetSerializers(archetype);
+                std::vector<unsigned char>& values = serialized.emplace_back();
+                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                    if (!serializers[i])
+                        continue;
+
+                    const std::size_t size = archetype->components[i]->GetSize();
+                    for (std::size_t c = 0; c < GetUsedChunks(archetype); ++c) {
+                        const Chunk& chunk = archetype->chunks[c];
+                        for (std::size_t row = 0; row < chunk.count; ++row) {
+                            serializers[i]->save(archetype->GetColumn(chunk, i) + row * size, values);
+                        }
+                    }
+                }
+            }
+
+            std::vector<unsigned char> header;
+            WriteValue(header, WORLD_FILE_MAGIC);
+            WriteValue(header, WORLD_FILE_VERSION);
+            WriteValue(header, static_cast<std::uint64_t>(CHUNK_SIZE));
+            WriteValue(header, static_cast<std::uint32_t>(types.size()));
+            WriteValue(header, static_cast<std::uint32_t>(archetypes.size()));
+
+            for (const ComponentTypeID& compTypeId : types) {
+                const ComponentBase* comp = m_ComponentMap.at(compTypeId);
+                WriteValue(header, comp->GetTypeID());
+                WriteValue(header, static_cast<std::uint64_t>(comp->GetSize()));
+                WriteValue(header, static_cast<std::uint64_t>(comp->GetAlignment()));
+                WriteValue(header, static_cast<std::uint32_t>(IsWorldFileSerialized(comp)));
+            }
+
+            WriteEntitySlots(header);
+
+            // data offsets are patched in once the size of the tables is known
+            std::vector<std::size_t> dataOffsetFields;
+            std::vector<std::size_t> serializedOffsetFields;
+            for (std::size_t a = 0; a < archetypes.size(); ++a) {
+                const Archetype* archetype = archetypes[a];
+                WriteValue(header, static_cast<std::uint32_t>(archetype->type.size()));
+                WriteValue(header, static_cast<std::uint64_t>(archetype->entityCount));
+                WriteValue(header, static_cast<std::uint64_t>(GetUsedChunks(archetype)));
+                WriteValue(header, static_cast<std::uint64_t>(archetype->chunkCapacity));
+                WriteValue(header, static_cast<std::uint64_t>(archetype->chunkBytes));
+                WriteValue(header, static_cast<std::uint64_t>(GetWorldFileStride(archetype)));
+                dataOffsetFields.push_back(header.size());
+                WriteValue(header, static_cast<std::uint64_t>(0));
+                serializedOffsetFields.push_back(header.size());
+                WriteValue(header, static_cast<std::uint64_t>(0));
+                WriteValue(header, static_cast<std::uint64_t>(serialized[a].size()));
+
+                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                    WriteValue(header, typeIndex.at(archetype->type[i]));
+                    WriteValue(header, static_cast<std::uint64_t>(archetype->columnOffsets[i]));
+                }
+            }
+
+            std::uint64_t offset = header.size();
+            for (std::size_t a = 0; a < archetypes.size(); ++a) {
+                const Archetype* archetype = archetypes[a];
+                offset = AlignUp(offset, std::max(MappedFile::PAGE_ALIGNMENT, archetype->chunkAlignment));
+                std::memcpy(&header[dataOffsetFields[a]], &offset, sizeof(offset));
+                offset += GetUsedChunks(archetype) * GetWorldFileStride(archetype);
+            }
+
+            for (std::size_t a = 0; a < archetypes.size(); ++a) {
+                std::memcpy(&header[serializedOffsetFields[a]], &offset, sizeof(offset));
+                offset += serialized[a].size();
+            }
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                throw std::runtime_error("Cannot Open World File!");
+            }
+
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+            offset = header.size();
+
+            // rows are copied into a zeroed block so padding and unused rows are written as zeros
+            std::vector<unsigned char> block;
+            for (const Archetype* archetype : archetypes) {
+                const std::size_t stride = GetWorldFileStride(archetype);
+                const std::size_t dataOffset = AlignUp(offset, std::max(MappedFile::PAGE_ALIGNMENT,
+                                                                        archetype->chunkAlignment));
+                block.assign(dataOffset - offset, 0);
+                file.write(reinterpret_cast<const char*>(block.data()), block.size());
+
+                for (std::size_t c = 0; c < GetUsedChunks(archetype); ++c) {
+                    const Chunk& chunk = archetype->chunks[c];
+                    block.assign(stride, 0);
+
+                    std::memcpy(block.data(), archetype->GetEntityIds(chunk), chunk.count * sizeof(EntityID));
+                    for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                        if (IsWorldFileSerialized(archetype->components[i]))
+                            continue;
+
+                        std::memcpy(block.data() + archetype->columnOffsets[i],
+                                    archetype->GetColumn(chunk, i),
+                                    chunk.count * archetype->components[i]->GetSize());
+                    }
+
+                    file.write(reinterpret_cast<const char*>(block.data()), block.size());
+                }
+
+                offset = dataOffset + GetUsedChunks(archetype) * stride;
+            }
+
+            for (const std::vector<unsigned char>& values : serialized) {
+                file.write(reinterpret_cast<const char*>(values.data()), values.size());
+            }
+
+            if (!file) {
+                throw std::runtime_error("Cannot Write World File!");
+            }
+        }
+
+        /* Replaces every entity with the ones in a world file. The file is memory mapped
+         * and chunks whose layout matches this build are adopted in place, copy-on-write,
+         * without copying any trivially copyable column; serialized values are constructed
+         * into them. The file stays mapped until the last of them is released. Other
+         * chunks are copied column by column. Component types are matched by type id.
+         * The whole file is checked before any entity is replaced, so a file that cannot
+         * be loaded throws and leaves the world as it was. */
+        void LoadWorld(const std::string& path) {
+            std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+            if (!file->Open(path)) {
+                throw std::runtime_error("Cannot Open World File!");
+            }
+
+            const unsigned char* cursor = file->GetData();
+            const unsigned char* const end = file->GetData() + file->GetSize();
+
+            if (ReadValue<std::uint32_t>(cursor, end) != WORLD_FILE_MAGIC ||
+                ReadValue<std::uint32_t>(cursor, end) != WORLD_FILE_VERSION) {
+                throw std::runtime_error("Unsupported World File!");
+            }
+
+            ReadValue<std::uint64_t>(cursor, end);
+            const std::uint32_t typeCount = ReadValue<std::uint32_t>(cursor, end);
+            const std::uint32_t archetypeCount = ReadValue<std::uint32_t>(cursor, end);
+
+            std::vector<const ComponentBase*> types;
+            for (std::uint32_t t = 0; t < typeCount; ++t) {
+                const ComponentTypeID compTypeId = ReadValue<ComponentTypeID>(cursor, end);
+                const std::uint64_t size = ReadValue<std::uint64_t>(cursor, end);
+                ReadValue<std::uint64_t>(cursor, end);
+                const bool serialized = ReadValue<std::uint32_t>(cursor, end) != 0;
+
+                ComponentTypeIDBaseMap::const_iterator found = m_ComponentMap.find(compTypeId);
+                if (found == m_ComponentMap.end()) {
+                    throw std::runtime_error("Component Not Registered!");
+                }
+
+                const ComponentBase* comp = found->second;
+                if (comp->GetSize() != size || IsWorldFileSerialized(comp) != serialized) {
+                    throw std::runtime_error("World File Type Mismatch!");
+                }
+                if (serialized && !m_Serializers.contains(compTypeId)) {
+                    throw std::runtime_error("Component Has No Serializer!");
+                }
+                types.push_back(comp);
+            }
+
+            EntitySlotArray slots;
+            std::uint32_t freeSlot;
+            ReadEntitySlots(cursor, end, slots, freeSlot);
+
+            std::vector<WorldFileArchetype> archetypes;
+            std::vector<bool> loaded(slots.size(), false);
+            for (std::uint32_t a = 0; a < archetypeCount; ++a) {
+                archetypes.push_back(ReadWorldFileArchetype(cursor, end, types, *file));
+                CheckWorldFileEntities(archetypes.back(), *file, slots, loaded);
+            }
+
+            m_Commands.Clear();
+            m_ReservedSlots = 0;
+            ClearEntities();
+            m_Entities = std::move(slots);
+            m_FreeSlot = freeSlot;
+
+            // registered up front so chunks adopted before a throw keep their mapping
+            MappedFile* mapped = file.get();
+            m_WorldFiles.push_back({std::move(file), 0});
+
+            try {
+                for (const WorldFileArchetype& fileArchetype : archetypes) {
+                    LoadWorldArchetype(fileArchetype, mapped);
+                }
+            } catch (...) {
+                ClearEntities();
+                ReleaseEntitySlots();
+                ReleaseUnusedWorldFile(mapped);
+                throw;
+            }
+
+            ReleaseUnusedWorldFile(mapped);
+        }
+
+        template<class T>
+        static IDType GetResourceTypeID() {
+            return TypeIdGenerator<Res<void>>::GetNewID<std::remove_const_t<T>>();
+        }
+
+        /* Creates (or replaces) the ECS's single instance of T. Resources live outside the
+         * archetypes in a flat array indexed by resource type id. Not safe to call while
+         * systems are running. */
+        template<class T, typename... Args>
+        T* SetResource(Args&&... args) {
+            IDType resourceTypeId = GetResourceTypeID<T>();
+
+            if (m_Resources.size() <= static_cast<std::size_t>(resourceTypeId))
+                m_Resources.resize(resourceTypeId + 1);
+
+            std::shared_ptr<T> resource = std::make_shared<T>(std::forward<Args>(args)...);
+            m_Resources[resourceTypeId] = resource;
+            return resource.get();
+        }
+
+        // Returns nullptr if the resource was never set
+        template<class T>
+        T* Resource() const {
+            return Resource<T>(GetResourceTypeID<T>());
+        }
+
+        // Same, for an id from GetResourceTypeID<T> that the caller resolved up front
+        template<class T>
+        T* Resource(IDType resourceTypeId) const {
+            return static_cast<std::size_t>(resourceTypeId) < m_Resources.size()
+                   ? static_cast<T*>(m_Resources[resourceTypeId].get())
+                   : nullptr;
+        }
+
+        template<class T>
+        void RemoveResource() {
+            std::size_t resourceTypeId = GetResourceTypeID<T>();
+
+            if (resourceTypeId < m_Resources.size())
+                m_Resources[resourceTypeId].reset();
+        }
+
+        /* Double-buffers C: WriteBuffers copies every value of C into a write buffer and
+         * SwapBuffers publishes it, so a render thread can read the previous tick through
+         * GetReadBuffer while the next one simulates. Select components during setup,
+         * before any other thread reads buffers. C must be trivially copyable. */
+        template<class C>
+        void BufferComponent() {
+            static_assert(std::is_trivially_copyable_v<C> && !IsTagComponent<C>::value,
+                          "Only trivially copyable components with data can be double-buffered");
+
+            if (!IsComponentRegistered<C>()) {
+                throw std::runtime_error("Component Not Registered!");
+            }
+
+            ComponentTypeID compTypeId = Component<C>::GetTypeID();
+            if (!m_ComponentBuffers.contains(compTypeId))
+                m_ComponentBuffers.emplace(compTypeId, std::make_unique<ComponentBuffer<C>>(GetQuery({compTypeId})));
+        }
+
+        /* Copies the current values of the double-buffered components into their write
+         * buffers. Call between ticks, with no systems running; readers of the read
+         * buffers are not disturbed. */
+        void WriteBuffers() {
+            for (ComponentBufferMap::value_type& b : m_ComponentBuffers) {
+                ComponentBufferBase* buffer = b.second.get();
+                const Query* query = buffer->GetQuery();
+
+                std::size_t count = 0;
+                for (const Archetype* archetype : query->archetypes) {
+                    count += archetype->entityCount;
+                }
+
+                EntityID* entityIds = buffer->ResizeWrite(count);
+                unsigned char* values = buffer->GetWriteValues();
+
+                for (std::size_t a = 0; a < query->archetypes.size(); ++a) {
+                    const Archetype* archetype = query->archetypes[a];
+                    const std::size_t column = query->GetColumns(a)[0];
+                    const std::size_t size = archetype->components[column]->GetSize();
+
+                    for (std::size_t c = 0; c < GetUsedChunks(archetype); ++c) {
+                        const Chunk& chunk = archetype->chunks[c];
+
+                        std::memcpy(entityIds, archetype->GetEntityIds(chunk), chunk.count * sizeof(EntityID));
+                        std::memcpy(values, archetype->GetColumn(chunk, column), chunk.count * size);
+                        entityIds += chunk.count;
+                        values += chunk.count * size;
+                    }
+                }
+            }
+        }
+
+        // Publishes the write buffers. Nothing may be reading the read buffers meanwhile.
+        void SwapBuffers() {
+            for (ComponentBufferMap::value_type& b : m_ComponentBuffers) {
+                b.second->Swap();
+            }
+        }
+
+        // The values of C as of the last SwapBuffers, or empty if C is not buffered
+        template<class C>
+        BufferedView<C> GetReadBuffer() const {
+            ComponentBufferMap::const_iterator found = m_ComponentBuffers.find(Component<C>::GetTypeID());
+
+            return found != m_ComponentBuffers.end()
+                   ? static_cast<const ComponentBuffer<C>*>(found->second.get())->GetRead()
+                   : BufferedView<C>();
+        }
+
+        CommandBuffer& GetCommandBuffer() {
+            return m_Commands;
+        }
+
+        /* Applies and clears a command buffer. Commands are sorted by entity and folded
+         * into one final archetype per entity, then entities are moved grouped by that
+         * archetype with its chunks reserved up front, so each entity moves once. */
+        void Playback(CommandBuffer& commands) {
+            typedef CommandBuffer::Command Command;
+            typedef CommandBuffer::CommandType CommandType;
+
+            // entities created by the buffer exist from here on, with or without commands
+            AddReservedSlots();
+
+            std::vector<Command>& queue = commands.m_Commands;
+            if (queue.empty())
+                return;
+
+            std::stable_sort(queue.begin(), queue.end(),
+                             [](const Command& a, const Command& b) {
+                return a.entity < b.entity;
+            });
+
+            struct PendingMove
+            {
+                EntityID entity;
+                Archetype* target;
+                std::size_t firstPayload;
+                std::size_t lastPayload;
+            };
+
+            std::vector<EntityID> destroyed;
+            std::vector<PendingMove> moves;
+            std::vector<std::size_t> payloads;
+
+            for (std::size_t c = 0; c < queue.size();) {
+                const EntityID entityId = queue[c].entity;
+                const std::size_t first = c;
+                while (c < queue.size() && queue[c].entity == entityId) {
+                    ++c;
+                }
+
+                Record* record = GetRecord(entityId);
+                if (!record)
+                    continue;
+
+                Archetype* current = record->archetype ? record->archetype : m_EmptyArchetype;
+                Archetype* target = current;
+                bool destroy = false;
+                std::size_t firstPayload = payloads.size();
+
+                for (std::size_t k = first; k < c && !destroy; ++k) {
+                    const Command& command = queue[k];
+                    bool present = std::binary_search(target->type.begin(),
+                                                      target->type.end(),
+                                                      command.componentId);
+
+                    switch (command.type) {
+                        case CommandType::Destroy:
+                            destroy = true;
+                            break;
+                        case CommandType::Add:
+                            if (!m_ComponentMap.contains(command.componentId)) {
+                                throw std::runtime_error("Component Not Registered!");
+                            }
+
+                            if (!present) {
+                                target = GetAddTarget(target, command.componentId);
+                                payloads.push_back(k);
+                            }
+                            break;
+                        case CommandType::Remove:
+                            if (present) {
+                                target = GetRemoveTarget(target, command.componentId);
+                                payloads.erase(std::remove_if(payloads.begin() + firstPayload,
+                                                              payloads.end(),
+                                                              [&](const std::size_t& p) {
+                                    return queue[p].componentId == command.componentId;
+                                }), payloads.end());
+                            }
+                            break;
+                    }
+                }
+
+                if (destroy) {
+                    payloads.resize(firstPayload);
+                    destroyed.push_back(entityId);
+                } else if (target != current || payloads.size() != firstPayload) {
+                    moves.push_back({entityId, target, firstPayload, payloads.size()});
+                }
+            }
+
+            DestroyEntities(destroyed);
+
+            std::stable_sort(moves.begin(), moves.end(),
+                             [](const PendingMove& a, const PendingMove& b) {
+                return a.target < b.target;
+            });
+
+            for (std::size_t m = 0; m < moves.size();) {
+                Archetype* target = moves[m].target;
+                std::size_t end = m;
+                while (end < moves.size() && moves[end].target == target) {
+                    ++end;
+                }
+
+                ReserveRows(target, end - m);
+
+                for (; m < end; ++m) {
+                    const PendingMove& move = moves[m];
+                    Record& record = *GetRecord(move.entity);
+                    Archetype* oldArchetype = record.archetype;
+
+                    if (target != (oldArchetype ? oldArchetype : m_EmptyArchetype))
+                        MoveEntity(move.entity, record, target);
+
+                    for (std::size_t p = move.firstPayload; p < move.lastPayload; ++p) {
+                        Command& command = queue[payloads[p]];
+                        std::size_t column = std::lower_bound(target->type.begin(),
+                                                              target->type.end(),
+                                                              command.componentId)
+                                             - target->type.begin();
+                        ComponentData data = GetComponentData(target, column, record.index);
+
+                        // removed and re-added: the carried over value gets replaced
+                        if (oldArchetype && std::binary_search(oldArchetype->type.begin(),
+                                                               oldArchetype->type.end(),
+                                                               command.componentId))
+                            target->components[column]->Destroy(data, 1);
+
+                        if (command.payload)
+                            command.component->Relocate(command.payload, data, 1);
+                        command.payload = nullptr;
+                        MarkAdded(target, column, record.index);
+                    }
+                }
+            }
+
+            commands.Clear();
+        }
+
+        Archetype* GetArchetype(const ArcheTypeID& id) {
+            ArchetypeIndexMap::iterator existing = m_ArchetypeIndex.find(id);
+            if(existing != m_ArchetypeIndex.end())
+                return existing->second;
+
+            // archetype doesn't exist, so create a new one
+
+            Archetype* newArchetype = new Archetype;
+            newArchetype->type = id;
+            newArchetype->entityCount = 0;
+            newArchetype->reservedChunks = 0;
+            m_Archetypes.push_back(newArchetype);
+            m_ArchetypeIndex.emplace(id, newArchetype);
+
+            for(ArcheTypeID::size_type i = 0; i < id.size(); ++i)
+            {
+                newArchetype->components.push_back(m_ComponentMap[id[i]]);
+            }
+
+            LayoutArchetype(newArchetype);
+
+            for(QueryMap::value_type& q : m_Queries)
+            {
+                if(Matches(q.second, id))
+                    AddToQuery(q.second, newArchetype);
+            }
+
+            return newArchetype;
+        }
+
+        // Archetype reached by adding compTypeId, resolved through the cached edge when possible
+        Archetype* GetAddTarget(Archetype* archetype, ComponentTypeID compTypeId) {
+            ArchetypeEdgeMap::iterator edge = archetype->addEdges.find(compTypeId);
+            if(edge != archetype->addEdges.end())
+                return edge->second;
+
+            ArcheTypeID newArchetypeId = archetype->type;
+            newArchetypeId.insert(std::lower_bound(newArchetypeId.begin(),
+                                                   newArchetypeId.end(),
+                                                   compTypeId),
+                                  compTypeId);
+
+            Archetype* target = GetArchetype(newArchetypeId);
+            archetype->addEdges[compTypeId] = target;
+            target->removeEdges[compTypeId] = archetype;
+
+            return target;
+        }
+
+        // Archetype reached by removing compTypeId, resolved through the cached edge when possible
+        Archetype* GetRemoveTarget(Archetype* archetype, ComponentTypeID compTypeId) {
+            ArchetypeEdgeMap::iterator edge = archetype->removeEdges.find(compTypeId);
+            if(edge != archetype->removeEdges.end())
+                return edge->second;
+
+            ArcheTypeID newArchetypeId = archetype->type;
+            newArchetypeId.erase(std::remove(newArchetypeId.begin(),
+                                             newArchetypeId.end(),
+                                             compTypeId),
+                                 newArchetypeId.end());
+
+            Archetype* target = GetArchetype(newArchetypeId);
+            archetype->removeEdges[compTypeId] = target;
+            target->addEdges[compTypeId] = archetype;
+
+            return target;
+        }
+
+        template<class C, typename... Args>
+        C* AddComponent(const EntityID& entityId, Args&&... args) {
+            ComponentTypeID newCompTypeId = Component<C>::GetTypeID();
+
+            if(!IsComponentRegistered<C>())
+            {
+                throw std::runtime_error("Component Not Registered!");
+            }
+
+            Record* recordPtr = GetRecord(entityId);
+            if(!recordPtr)
+            {
+                throw std::runtime_error("Entity Not Alive!");
+            }
+
+            Record& record = *recordPtr;
+            Archetype* oldArchetype = record.archetype;
+
+            if(oldArchetype &&
+               std::binary_search(oldArchetype->type.begin(),
+                                  oldArchetype->type.end(),
+                                  newCompTypeId))
+            {
+                // this entity already contains this component
+                return nullptr;
+            }
+
+            Archetype* newArchetype = GetAddTarget(oldArchetype ? oldArchetype : m_EmptyArchetype,
+                                                   newCompTypeId);
+
+            MoveEntity(entityId, record, newArchetype);
+
+            // the new column is the only one MoveEntity left uninitialized
+            std::size_t column = std::lower_bound(newArchetype->type.begin(),
+                                                  newArchetype->type.end(),
+                                                  newCompTypeId) - newArchetype->type.begin();
+
+            MarkAdded(newArchetype, column, record.index);
+
+            return ConstructComponent<C>(GetComponentData(newArchetype, column, record.index),
+                                         std::forward<Args>(args)...);
+        }
+
+        template<class C>
+        void RemoveComponent(const EntityID& entityId) {
+            if (!IsComponentRegistered<C>()) {
+                return;
+            }
+
+            ComponentTypeID compTypeId = Component<C>::GetTypeID();
+
+            Record* recordPtr = GetRecord(entityId);
+            if (!recordPtr) {
+                return;
+            }
+
+            Record& record = *recordPtr;
+            Archetype* oldArchetype = record.archetype;
+
+            if (!oldArchetype) {
+                return;
+            }
+
+            if (!std::binary_search(oldArchetype->type.begin(),
+                                    oldArchetype->type.end(),
+                                    compTypeId)) {
+                return;
+            }
+
+            Archetype* newArchetype = GetRemoveTarget(oldArchetype, compTypeId);
+
+            MoveEntity(entityId, record, newArchetype);
+        }
+
+        /* Creates count entities directly in the Cs... archetype: its chunks are reserved once
+         * and every component is default-constructed in place, then initializer(i, cs...)
+         * fills in entity i. No intermediate archetypes are visited. */
+        template<class... Cs, typename Init>
+        requires std::is_invocable_v<Init&, std::size_t, Cs&...>
+        std::vector<EntityID> Spawn(const std::size_t count, Init&& initializer) {
+            return SpawnRows<Cs...>(count, [&](std::size_t i, Cs*... cs) {
+                initializer(i, *ConstructComponent<Cs>(reinterpret_cast<ComponentData>(cs))...);
+            }, std::index_sequence_for<Cs...>());
+        }
+
+        // Creates count entities whose components are copies of values
+        template<class... Cs>
+        std::vector<EntityID> Spawn(const std::size_t count, std::tuple<Cs...> values) {
+            return SpawnRows<Cs...>(count, [&](std::size_t, Cs*... cs) {
+                (ConstructComponent<Cs>(reinterpret_cast<ComponentData>(cs), std::get<Cs>(values)), ...);
+            }, std::index_sequence_for<Cs...>());
+        }
+
+        void DestroyEntity(const EntityID& entityId) {
+            Record* record = GetRecord(entityId);
+            if (!record) {
+                return;
+            }
+
+            if (Archetype* archetype = record->archetype) {
+                DestroyRowData(archetype, record->index);
+                FreeRow(archetype, record->index);
+            }
+
+            ReleaseID(entityId);
+        }
+
+        /* Destroys a batch of entities. Rows are grouped by archetype so each archetype
+         * is compacted once, no matter how many of its entities go away. Stale handles
+         * and duplicates are skipped. */
+        void DestroyEntities(std::span<const EntityID> entityIds) {
+            std::vector<std::pair<Archetype*, std::size_t>> rows;
+            rows.reserve(entityIds.size());
+
+            for (const EntityID& entityId : entityIds) {
+                Record* record = GetRecord(entityId);
+                if (!record) {
+                    continue;
+                }
+
+                if (record->archetype) {
+                    DestroyRowData(record->archetype, record->index);
+                    rows.emplace_back(record->archetype, record->index);
+                }
+
+                ReleaseID(entityId);
+            }
+
+            std::sort(rows.begin(), rows.end(),
+                      [](const std::pair<Archetype*, std::size_t>& a,
+                         const std::pair<Archetype*, std::size_t>& b) {
+                return a.first != b.first ? a.first < b.first : a.second > b.second;
+            });
+
+            std::vector<std::size_t> archetypeRows;
+            for (std::size_t r = 0; r < rows.size();) {
+                Archetype* archetype = rows[r].first;
+
+                archetypeRows.clear();
+                for (; r < rows.size() && rows[r].first == archetype; ++r) {
+                    archetypeRows.push_back(rows[r].second);
+                }
+
+                FreeRows(archetype, archetypeRows);
+            }
+        }
+
+    private:
+
+        template<class... Cs, typename Construct, std::size_t... Is>
+        std::vector<EntityID> SpawnRows(const std::size_t count,
+                                        Construct&& construct,
+                                        std::index_sequence<Is...>) {
+            static_assert(sizeof...(Cs) > 0, "Spawn needs at least one component");
+
+            Archetype* archetype = GetArchetypeOf<Cs...>();
+            const ArcheTypeID& archetypeId = archetype->type;
+            ReserveRows(archetype, count);
+
+            const std::size_t columns[] = {
+                    static_cast<std::size_t>(std::lower_bound(archetypeId.begin(),
+                                                              archetypeId.end(),
+                                                              Component<Cs>::GetTypeID())
+                                             - archetypeId.begin())...
+            };
+
+            std::vector<EntityID> entityIds;
+            entityIds.reserve(count);
+
+            for (std::size_t i = 0; i < count; ++i) {
+                EntityID entityId = GetNewID();
+                Record& record = m_Entities[GetEntityIndex(entityId)].record;
+                record.archetype = archetype;
+                record.index = AllocateRow(archetype, entityId);
+
+                const Chunk& chunk = archetype->chunks[record.index / archetype->chunkCapacity];
+                const std::size_t slot = record.index % archetype->chunkCapacity;
+
+                construct(i, (reinterpret_cast<Cs*>(archetype->GetColumn(chunk, columns[Is])) + slot)...);
+                (MarkAdded(archetype, columns[Is], record.index), ...);
+                entityIds.push_back(entityId);
+            }
+
+            return entityIds;
+        }
+
+        // The archetype holding exactly Cs...
+        template<class... Cs>
+        Archetype* GetArchetypeOf() {
+            if (!(IsComponentRegistered<Cs>() && ...)) {
+                throw std::runtime_error("Component Not Registered!");
+            }
+
+            ArcheTypeID archetypeId = {Component<Cs>::GetTypeID()...};
+            std::sort(archetypeId.begin(), archetypeId.end());
+            if (std::adjacent_find(archetypeId.begin(), archetypeId.end()) != archetypeId.end()) {
+                throw std::runtime_error("Duplicate Component in Archetype!");
+            }
+
+            return GetArchetype(archetypeId);
+        }
+
+        template<class C, typename... Args>
+        static C* ConstructComponent(ComponentData data, Args&&... args) {
+            if constexpr (IsTagComponent<C>::value) {
+                return GetTagInstance<C>();
+            } else {
+                return new (data) C(std::forward<Args>(args)...);
+            }
+        }
+
+        // Every run gets its own tick, so a system sees writes made after it last ran
+        void RunSystem(const SystemEntry& entry, const float elapsedMilliseconds) {
+            SystemBase& system = *entry.system;
+            system.m_RunTick = ++m_ChangeTick;
+
+            const Query* query = entry.query;
+            for (std::size_t a = 0; a < query->archetypes.size(); ++a) {
+                Archetype* archetype = query->archetypes[a];
+                if (archetype->entityCount > 0)
+                    system.DoAction(elapsedMilliseconds, archetype, query->GetColumns(a));
+            }
+
+            system.m_LastRunTick = system.m_RunTick;
+        }
+
+        // New values count as written after every run so far
+        void MarkAdded(Archetype* archetype, std::size_t column, std::size_t index) {
+            Chunk& chunk = archetype->chunks[index / archetype->chunkCapacity];
+            const ChangeTick tick = m_ChangeTick.load(std::memory_order_relaxed) + 1;
+
+            chunk.addedTicks[column] = tick;
+            chunk.changedTicks[column] = tick;
+        }
+
+        /* Ticks are kept per chunk, so a value moving to another chunk raises that chunk's
+         * ticks to its own; otherwise Changed and Added parameters would lose it. */
+        static void CarryTicks(const Chunk& src, std::size_t srcColumn, Chunk& dst, std::size_t dstColumn) {
+            if (IsNewerTick(src.changedTicks[srcColumn], dst.changedTicks[dstColumn]))
+                dst.changedTicks[dstColumn] = src.changedTicks[srcColumn];
+
+            if (IsNewerTick(src.addedTicks[srcColumn], dst.addedTicks[dstColumn]))
+                dst.addedTicks[dstColumn] = src.addedTicks[srcColumn];
+        }
+
+        static void AddToQuery(Query* query, Archetype* archetype) {
+            query->archetypes.push_back(archetype);
+
+            for (const ComponentTypeID& compTypeId : query->columnIds) {
+                ArcheTypeID::const_iterator column = std::lower_bound(archetype->type.begin(),
+                                                                      archetype->type.end(),
+                                                                      compTypeId);
+                query->columns.push_back(column != archetype->type.end() && *column == compTypeId
+                                         ? column - archetype->type.begin()
+                                         : Query::MISSING_COLUMN);
+            }
+        }
+
+        static bool Matches(const Query* query, const ArcheTypeID& type) {
+            return std::includes(type.begin(), type.end(), query->key.begin(), query->key.end()) &&
+                   !Intersects(type, query->exclude);
+        }
+
+        // Both ids must be sorted
+        static bool Intersects(const ArcheTypeID& a, const ArcheTypeID& b) {
+            ArcheTypeID::const_iterator i = a.begin();
+            ArcheTypeID::const_iterator j = b.begin();
+
+            while (i != a.end() && j != b.end()) {
+                if (*i < *j)
+                    ++i;
+                else if (*j < *i)
+                    ++j;
+                else
+                    return true;
+            }
+
+            return false;
+        }
+
+        // Returns nullptr for stale or unknown handles
+        Record* GetRecord(const EntityID& entityId) {
+            return IsAlive(entityId) ? &m_Entities[GetEntityIndex(entityId)].record : nullptr;
+        }
+
+        // Bumps the slot version so outstanding handles go stale, then recycles the slot
+        void ReleaseID(const EntityID& entityId) {
+            std::uint32_t index = GetEntityIndex(entityId);
+            EntitySlot& slot = m_Entities[index];
+
+            if (++slot.version == 0)
+                slot.version = 1;
+
+            // ReserveID hands the slot out as it is, so it must not point at a row
+            slot.record.archetype = nullptr;
+            slot.record.index = 0;
+
+            slot.nextFree = m_FreeSlot;
+            m_FreeSlot = index;
+        }
+
+        void AddReservedSlots() {
+            EntitySlot slot;
+            slot.record.archetype = nullptr;
+            slot.record.index = 0;
+            slot.version = 1;
+            slot.nextFree = NO_FREE_SLOT;
+
+            m_Entities.resize(m_Entities.size() + m_ReservedSlots, slot);
+            m_ReservedSlots = 0;
+        }
+
+        static std::size_t AlignUp(std::size_t value, std::size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        ComponentData GetComponentData(Archetype* archetype,
+                                       std::size_t column,
+                                       std::size_t index) const {
+            const Chunk& chunk = archetype->chunks[index / archetype->chunkCapacity];
+            return archetype->GetColumn(chunk, column)
+                   + (index % archetype->chunkCapacity) * archetype->components[column]->GetSize();
+        }
+
+        // Columns start at multiples of max(alignof(C), COLUMN_ALIGNMENT) inside an equally aligned chunk, tags get none
+        void LayoutArchetype(Archetype* archetype) {
+            std::size_t rowSize = sizeof(EntityID);
+            std::size_t padding = COLUMN_ALIGNMENT;
+            std::size_t chunkAlignment = COLUMN_ALIGNMENT;
+            for (const ComponentBase* comp : archetype->components) {
+                if (comp->IsTag())
+                    continue;
+
+                std::size_t alignment = std::max(comp->GetAlignment(), COLUMN_ALIGNMENT);
+                rowSize += comp->GetSize();
+                padding += alignment;
+                chunkAlignment = std::max(chunkAlignment, alignment);
+            }
+
+            // every column may need padding up to its alignment
+            std::size_t capacity = CHUNK_SIZE > padding ? (CHUNK_SIZE - padding) / rowSize : 0;
+            if (capacity == 0)
+                capacity = 1;
+
+            std::size_t offset = capacity * sizeof(EntityID);
+            for (const ComponentBase* comp : archetype->components) {
+                if (comp->IsTag()) {
+                    archetype->columnOffsets.push_back(0);
+                    continue;
+                }
+
+                offset = AlignUp(offset, std::max(comp->GetAlignment(), COLUMN_ALIGNMENT));
+                archetype->columnOffsets.push_back(offset);
+                offset += capacity * comp->GetSize();
+            }
+
+            archetype->chunkCapacity = capacity;
+            archetype->chunkBytes = std::max(CHUNK_SIZE, AlignUp(offset, chunkAlignment));
+            archetype->chunkAlignment = chunkAlignment;
+        }
+
+        template<typename T>
+        static void WriteValue(std::vector<unsigned char>& blob, const T& value) {
+            WriteBytes(blob, &value, sizeof(T));
+        }
+
+        static void WriteBytes(std::vector<unsigned char>& blob, const void* data, std::size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            blob.insert(blob.end(), bytes, bytes + size);
+        }
+
+        template<typename T>
+        static T ReadValue(const unsigned char*& cursor, const unsigned char* end) {
+            T value;
+            ReadBytes(cursor, end, &value, sizeof(T));
+            return value;
+        }
+
+        static void ReadBytes(const unsigned char*& cursor, const unsigned char* end,
+                              void* data, std::size_t size) {
+            if (static_cast<std::size_t>(end - cursor) < size) {
+                throw std::runtime_error("Corrupt Snapshot!");
+            }
+
+            std::memcpy(data, cursor, size);
+            cursor += size;
+        }
+
+        void WriteEntitySlots(std::vector<unsigned char>& blob) const {
+            WriteValue(blob, static_cast<std::uint32_t>(m_Entities.size()));
+            WriteValue(blob, m_FreeSlot);
+            for (const EntitySlot& slot : m_Entities) {
+                WriteValue(blob, slot.version);
+                WriteValue(blob, slot.nextFree);
+            }
+        }
+
+        // Entities come back without archetypes until IndexLoadedRows finds their rows
+        static void ReadEntitySlots(const unsigned char*& cursor, const unsigned char* end,
+                                    EntitySlotArray& slots, std::uint32_t& freeSlot) {
+            const std::uint32_t slotCount = ReadValue<std::uint32_t>(cursor, end);
+            if (slotCount > static_cast<std::size_t>(end - cursor) / (2 * sizeof(std::uint32_t))) {
+                throw std::runtime_error("Corrupt Snapshot!");
+            }
+
+            freeSlot = ReadValue<std::uint32_t>(cursor, end);
+            slots.resize(slotCount);
+            for (EntitySlot& slot : slots) {
+                slot.version = ReadValue<std::uint32_t>(cursor, end);
+                slot.nextFree = ReadValue<std::uint32_t>(cursor, end);
+                slot.record.archetype = nullptr;
+                slot.record.index = 0;
+
+                if (slot.nextFree != NO_FREE_SLOT && slot.nextFree >= slotCount) {
+                    throw std::runtime_error("Corrupt Snapshot!");
+                }
+            }
+
+            if (freeSlot != NO_FREE_SLOT && freeSlot >= slotCount) {
+                throw std::runtime_error("Corrupt Snapshot!");
+            }
+        }
+
+        // After a failed load: frees every slot and makes every handle to it stale
+        void ReleaseEntitySlots() {
+            m_FreeSlot = NO_FREE_SLOT;
+            for (std::size_t index = m_Entities.size(); index-- > 0;) {
+                EntitySlot& slot = m_Entities[index];
+                if (++slot.version == 0)
+                    slot.version = 1;
+
+                slot.record.archetype = nullptr;
+                slot.nextFree = m_FreeSlot;
+                m_FreeSlot = static_cast<std::uint32_t>(index);
+            }
+        }
+
+        /* Serializer of each column that is neither a tag nor trivially copyable, nullptr
+         * for the others. Throws if one of them has no serializer registered. */
+        std::vector<const ComponentSerializer*> GetSerializers(const Archetype* archetype) const {
+            std::vector<const ComponentSerializer*> serializers(archetype->type.size(), nullptr);
+
+            for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                const ComponentBase* comp = archetype->components[i];
+                if (comp->IsTag() || comp->IsTriviallyCopyable())
+                    continue;
+
+                ComponentSerializerMap::const_iterator found = m_Serializers.find(archetype->type[i]);
+                if (found == m_Serializers.end()) {
+                    throw std::runtime_error("Component Has No Serializer!");
+                }
+                serializers[i] = &found->second;
+            }
+
+            return serializers;
+        }
+
+        // A value the serializer built past the end is still counted, so that it gets destroyed
+        static void LoadValue(const ComponentSerializer& serializer,
+                              const unsigned char*& cursor, const unsigned char* end,
+                              ComponentData data, std::size_t& constructed) {
+            serializer.load(cursor, end, data);
+            ++constructed;
+            if (cursor > end) {
+                throw std::runtime_error("Corrupt Snapshot!");
+            }
+        }
+
+        /* Fills rows [0, entityCount) of an empty archetype whose chunks are reserved and
+         * whose entity ids are already written, one column at a time. read(column, row,
+         * data, count, constructed) constructs count values starting at row into data,
+         * which stays within one chunk, and adds each value to constructed as it goes.
+         * If it throws, only the values constructed so far are destroyed and the
+         * archetype stays empty; otherwise the rows become live. */
+        template<class F>
+        void LoadRows(Archetype* archetype, std::size_t entityCount, F read) {
+            std::size_t column = 0;
+            std::size_t constructed = 0;
+
+            try {
+                for (; column < archetype->type.size(); ++column) {
+                    if (archetype->components[column]->IsTag())
+                        continue;
+
+                    for (constructed = 0; constructed < entityCount;) {
+                        const std::size_t row = constructed;
+                        const Chunk& chunk = archetype->chunks[row / archetype->chunkCapacity];
+                        const std::size_t slot = row % archetype->chunkCapacity;
+                        const std::size_t count = std::min(archetype->chunkCapacity - slot, entityCount - row);
+
+                        read(column, row,
+                             archetype->GetColumn(chunk, column) + slot * archetype->components[column]->GetSize(),
+                             count, constructed);
+                    }
+                }
+            } catch (...) {
+                for (std::size_t i = 0; i <= column && i < archetype->type.size(); ++i) {
+                    DestroyRows(archetype, i, i < column ? entityCount : constructed);
+                }
+                throw;
+            }
 
-            m_ComponentMap.emplace(componentTypeId, new Component<C>);
+            archetype->entityCount = entityCount;
+            for (std::size_t row = 0; row < entityCount; row += archetype->chunkCapacity) {
+                archetype->chunks[row / archetype->chunkCapacity].count =
+                        std::min(archetype->chunkCapacity, entityCount - row);
+            }
         }
 
-        template<class C>
-        bool IsComponentRegistered() {
-            ComponentTypeID componentTypeId = Component<C>::GetTypeID();
-
-            return m_ComponentMap.contains(componentTypeId);
+        // Destroys the values in rows [0, count) of one column
+        void DestroyRows(Archetype* archetype, std::size_t column, std::size_t count) {
+            for (std::size_t row = 0; row < count; row += archetype->chunkCapacity) {
+                const Chunk& chunk = archetype->chunks[row / archetype->chunkCapacity];
+                archetype->components[column]->Destroy(archetype->GetColumn(chunk, column),
+                                                       std::min(archetype->chunkCapacity, count - row));
+            }
         }
 
-        void RegisterSystem(const std::uint8_t& layer, std::shared_ptr<SystemBase> system) {
-            m_Systems[layer].push_back(system);
-        }
+        // Points the records of a loaded archetype's entities at their rows and marks every column added
+        void IndexLoadedRows(Archetype* archetype) {
+            for (std::size_t c = 0; c < GetUsedChunks(archetype); ++c) {
+                const Chunk& chunk = archetype->chunks[c];
+                const EntityID* entityIds = archetype->GetEntityIds(chunk);
+
+                for (std::size_t row = 0; row < chunk.count; ++row) {
+                    std::uint32_t index = GetEntityIndex(entityIds[row]);
+                    if (index >= m_Entities.size() ||
+                        m_Entities[index].version != GetEntityVersion(entityIds[row]) ||
+                        m_Entities[index].record.archetype) {
+                        throw std::runtime_error("Corrupt Snapshot!");
+                    }
+                    m_Entities[index].record = {archetype, c * archetype->chunkCapacity + row};
+                }
 
-        void RegisterEntity(const EntityID entityId) {
-            Record dummyRecord;
-            dummyRecord.archetype = nullptr;
-            dummyRecord.index = 0;
-            m_Entities[entityId] = dummyRecord;
+                for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                    MarkAdded(archetype, i, c * archetype->chunkCapacity);
+                }
+            }
         }
 
-        void RunSystems(const std::uint8_t& layer, const float elapsedMilliseconds) {
-            for(const std::shared_ptr<SystemBase>& system : m_Systems[layer])
-            {
-                const ArcheTypeID& key = system->GetKey();
+        // Distance between chunks in a world file, which keeps every chunk page aligned
+        static std::size_t GetWorldFileStride(const Archetype* archetype) {
+            return AlignUp(archetype->chunkBytes, std::max(MappedFile::PAGE_ALIGNMENT, archetype->chunkAlignment));
+        }
 
-                for(Archetype* archetype: m_Archetypes)
-                {
-                    if(std::includes(archetype->type.begin(), archetype->type.end(),
-                                     key.begin(), key.end()))
-                    {
-                        system->DoAction(elapsedMilliseconds, archetype);
+        // Destroys the data of every entity and empties all archetypes, which stay registered
+        void ClearEntities() {
+            for (Archetype* archetype : m_Archetypes) {
+                for (Chunk& chunk : archetype->chunks) {
+                    for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                        archetype->components[i]->Destroy(archetype->GetColumn(chunk, i), chunk.count);
                     }
                 }
+
+                archetype->entityCount = 0;
+                TrimChunks(archetype);
             }
         }
 
-        Archetype* GetArchetype(const ArcheTypeID& id) {
-            for(Archetype* archetype : m_Archetypes)
-            {
-                if(archetype->type == id)
-                    return archetype;
+        void DestroyRowData(Archetype* archetype, std::size_t index) {
+            for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                archetype->components[i]->Destroy(GetComponentData(archetype, i, index), 1);
             }
+        }
 
-            // archetype doesn't exist, so create a new one
+        // Adopted chunks belong to their world file mapping
+        void FreeChunkData(const Archetype* archetype, const Chunk& chunk) {
+            if (!chunk.adopted)
+                m_Allocator->Free(chunk.data, archetype->chunkBytes, archetype->chunkAlignment);
+            else if (--GetWorldFile(chunk.data)->adoptedChunks == 0)
+                ReleaseWorldFile(chunk.data);
+        }
 
-            Archetype* newArchetype = new Archetype;
-            newArchetype->type = id;
-            m_Archetypes.push_back(newArchetype);
+        // The loaded world file whose mapping holds data
+        WorldFile* GetWorldFile(const unsigned char* data) {
+            const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data);
 
-            // add an empty array for each component in the type
-            for(ArcheTypeID::size_type i = 0; i < id.size(); ++i)
-            {
-                newArchetype->componentData.push_back(new unsigned char[0]);
-                newArchetype->componentDataSize.push_back(0);
+            for (WorldFile& worldFile : m_WorldFiles) {
+                const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(worldFile.file->GetData());
+                if (address >= begin && address < begin + worldFile.file->GetSize())
+                    return &worldFile;
             }
 
-            return newArchetype;
+            throw std::runtime_error("Chunk Not In A World File!");
         }
 
-        void PrepareCompData(ArcheTypeID newArchetypeId,
-                             Archetype* newArchetype,
-                             Archetype* oldArchetype,
-                             const Record& record) {
-            for (std::size_t j = 0; j < newArchetypeId.size(); ++j) {
-                const ComponentTypeID& newCompId = newArchetypeId[j];
-
-                const ComponentBase* const newComp = m_ComponentMap[newCompId];
-
-                const std::size_t& newCompDataSize = newComp->GetSize();
+        void ReleaseWorldFile(const unsigned char* data) {
+            WorldFile* worldFile = GetWorldFile(data);
+            m_WorldFiles.erase(m_WorldFiles.begin() + (worldFile - m_WorldFiles.data()));
+        }
 
-                std::size_t currentSize = newArchetype->entityIds.size() * newCompDataSize;
-                std::size_t newSize = currentSize + newCompDataSize;
-                if (newSize > newArchetype->componentDataSize[j]) {
-                    newArchetype->componentDataSize[j] *= 2;
-                    newArchetype->componentDataSize[j] += newCompDataSize;
-                    auto newData = new unsigned char[newSize];
+        // Such columns are left zeroed in a world file's chunks and written after them
+        static bool IsWorldFileSerialized(const ComponentBase* comp) {
+            return !comp->IsTag() && !comp->IsTriviallyCopyable();
+        }
 
-                    for (std::size_t e = 0; e < newArchetype->entityIds.size(); ++e) {
-                        newComp->MoveData(&newArchetype->componentData[j][e*newCompDataSize],
-                                          &newData[e*newCompDataSize]);
+        // Drops the mapping of file if it is still loaded without any adopted chunk
+        void ReleaseUnusedWorldFile(const MappedFile* file) {
+            for (std::size_t i = 0; i < m_WorldFiles.size(); ++i) {
+                if (m_WorldFiles[i].file.get() != file)
+                    continue;
 
-                        newComp->DestroyData(&newArchetype->componentData[j][e*newCompDataSize]);
-                    }
+                if (m_WorldFiles[i].adoptedChunks == 0)
+                    m_WorldFiles.erase(m_WorldFiles.begin() + i);
+                return;
+            }
+        }
 
-                    delete [] newArchetype->componentData[j];
+        // Reads and bounds checks one archetype table entry against the file it came from
+        static WorldFileArchetype ReadWorldFileArchetype(const unsigned char*& cursor, const unsigned char* end,
+                                                         const std::vector<const ComponentBase*>& types,
+                                                         const MappedFile& file) {
+            WorldFileArchetype fileArchetype;
+
+            const std::uint32_t columnCount = ReadValue<std::uint32_t>(cursor, end);
+            fileArchetype.entityCount = ReadValue<std::uint64_t>(cursor, end);
+            const std::size_t chunkCount = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.chunkCapacity = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.chunkBytes = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.stride = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.dataOffset = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.serializedOffset = ReadValue<std::uint64_t>(cursor, end);
+            fileArchetype.serializedBytes = ReadValue<std::uint64_t>(cursor, end);
+
+            const std::size_t capacity = fileArchetype.chunkCapacity;
+            const std::size_t chunkBytes = fileArchetype.chunkBytes;
+            if (capacity == 0 || chunkBytes / sizeof(EntityID) < capacity ||
+                fileArchetype.stride < chunkBytes || fileArchetype.dataOffset > file.GetSize() ||
+                (file.GetSize() - fileArchetype.dataOffset) / fileArchetype.stride < chunkCount ||
+                chunkCount * capacity < fileArchetype.entityCount ||
+                fileArchetype.serializedOffset > file.GetSize() ||
+                file.GetSize() - fileArchetype.serializedOffset < fileArchetype.serializedBytes) {
+                throw std::runtime_error("Corrupt World File!");
+            }
 
-                    newArchetype->componentData[j] = newData;
+            std::vector<std::pair<const ComponentBase*, std::size_t>> columns;
+            for (std::uint32_t i = 0; i < columnCount; ++i) {
+                const std::uint32_t index = ReadValue<std::uint32_t>(cursor, end);
+                const std::size_t columnOffset = ReadValue<std::uint64_t>(cursor, end);
+                if (index >= types.size()) {
+                    throw std::runtime_error("Corrupt World File!");
                 }
 
-                newComp->CreateData(&newArchetype->componentData[j][currentSize]);
+                // every row of the column has to lie within the chunk
+                const std::size_t size = types[index]->GetSize();
+                if (size != 0 && (columnOffset > chunkBytes || (chunkBytes - columnOffset) / size < capacity)) {
+                    throw std::runtime_error("Corrupt World File!");
+                }
 
-                ArcheTypeID oldArchetypeId = oldArchetype->type;
+                columns.emplace_back(types[index], columnOffset);
+            }
 
-                for (std::size_t i = 0; i < oldArchetype->type.size(); ++i) {
-                    const ComponentTypeID& oldCompId = oldArchetype->type[i];
+            std::sort(columns.begin(), columns.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.first->GetTypeID() < rhs.first->GetTypeID();
+            });
 
-                    if (oldCompId == newCompId) {
-                        const std::size_t& oldCompDataSize =
-                                m_ComponentMap[oldCompId]->GetSize();
+            for (std::size_t i = 0; i < columns.size(); ++i) {
+                if (i > 0 && columns[i].first == columns[i - 1].first) {
+                    throw std::runtime_error("Corrupt World File!");
+                }
 
-                        ComponentBase* removeWrapper = m_ComponentMap[oldCompId];
-                        removeWrapper->MoveData(&oldArchetype->componentData[i][record.index*oldCompDataSize],
-                                                &newArchetype->componentData[j][currentSize]);
+                fileArchetype.type.push_back(columns[i].first->GetTypeID());
+                fileArchetype.columnOffsets.push_back(columns[i].second);
+            }
 
-                        removeWrapper->DestroyData(&oldArchetype->componentData[i][record.index*oldCompDataSize]);
+            return fileArchetype;
+        }
 
-                        break;
-                    }
+        // Every entity id has to name a live slot of the file, and only once
+        static void CheckWorldFileEntities(const WorldFileArchetype& fileArchetype, const MappedFile& file,
+                                           const EntitySlotArray& slots, std::vector<bool>& loaded) {
+            const unsigned char* data = file.GetData() + fileArchetype.dataOffset;
+
+            for (std::size_t row = 0; row < fileArchetype.entityCount; ++row) {
+                EntityID entityId;
+                std::memcpy(&entityId,
+                            data + (row / fileArchetype.chunkCapacity) * fileArchetype.stride
+                                 + (row % fileArchetype.chunkCapacity) * sizeof(EntityID),
+                            sizeof(EntityID));
+
+                const std::uint32_t index = GetEntityIndex(entityId);
+                if (index >= slots.size() || slots[index].version != GetEntityVersion(entityId) || loaded[index]) {
+                    throw std::runtime_error("Corrupt World File!");
                 }
+                loaded[index] = true;
             }
         }
 
-        template<class C>
-        void RemoveTargetComponent(Archetype* oldArchetype,
-                                   ComponentTypeID compTypeId,
-                                   const Record& record) {
-            for (std::size_t i = 0; i < oldArchetype->type.size(); ++i) {
-                const ComponentTypeID& oldCompTypeId = oldArchetype->type[i];
+        // Loads one checked archetype of a world file into the matching archetype
+        void LoadWorldArchetype(const WorldFileArchetype& fileArchetype, MappedFile* mapped) {
+            Archetype* archetype = GetArchetype(fileArchetype.type);
+            const std::vector<const ComponentSerializer*> serializers = GetSerializers(archetype);
+            unsigned char* data = mapped->GetData() + fileArchetype.dataOffset;
+
+            const std::size_t entityCount = fileArchetype.entityCount;
+            const std::size_t chunkCapacity = fileArchetype.chunkCapacity;
+            const std::size_t stride = fileArchetype.stride;
+
+            bool sameLayout = chunkCapacity == archetype->chunkCapacity &&
+                              fileArchetype.chunkBytes == archetype->chunkBytes &&
+                              reinterpret_cast<std::uintptr_t>(data) % archetype->chunkAlignment == 0 &&
+                              stride % archetype->chunkAlignment == 0;
+            for (std::size_t i = 0; i < archetype->type.size() && sameLayout; ++i) {
+                sameLayout = archetype->components[i]->IsTag() ||
+                             fileArchetype.columnOffsets[i] == archetype->columnOffsets[i];
+            }
 
-                if (oldCompTypeId == compTypeId) {
-                    ComponentBase* removeWrapper = m_ComponentMap[compTypeId];
-                    removeWrapper->DestroyData(&oldArchetype->componentData[i][record.index*sizeof(C)]);
+            if (sameLayout) {
+                // the emptied chunks make way for the file's, which hold rows 0..n-1
+                for (const Chunk& chunk : archetype->chunks) {
+                    FreeChunkData(archetype, chunk);
+                }
+                archetype->chunks.clear();
+                archetype->reservedChunks = 0;
+
+                // only chunks holding rows, which LoadRows counts once their columns are built
+                const std::size_t usedChunks = (entityCount + chunkCapacity - 1) / chunkCapacity;
+                for (std::size_t c = 0; c < usedChunks; ++c) {
+                    Chunk chunk;
+                    chunk.data = data + c * stride;
+                    chunk.count = 0;
+                    chunk.changedTicks.assign(archetype->type.size(), 0);
+                    chunk.addedTicks.assign(archetype->type.size(), 0);
+                    chunk.adopted = true;
+                    archetype->chunks.push_back(std::move(chunk));
                 }
 
-                const ComponentBase* const oldComp = m_ComponentMap[oldCompTypeId];
-
-                const std::size_t& oldCompDataSize = oldComp->GetSize();
+                GetWorldFile(mapped->GetData())->adoptedChunks += usedChunks;
+            } else {
+                ReserveRows(archetype, entityCount);
+
+                // copy runs of ids that stay within one chunk on both sides
+                for (std::size_t row = 0; row < entityCount;) {
+                    const std::size_t srcSlot = row % chunkCapacity;
+                    const std::size_t dstSlot = row % archetype->chunkCapacity;
+                    const std::size_t run = std::min({chunkCapacity - srcSlot,
+                                                      archetype->chunkCapacity - dstSlot,
+                                                      entityCount - row});
+
+                    std::memcpy(archetype->GetEntityIds(archetype->chunks[row / archetype->chunkCapacity]) + dstSlot,
+                                data + (row / chunkCapacity) * stride + srcSlot * sizeof(EntityID),
+                                run * sizeof(EntityID));
+                    row += run;
+                }
+            }
 
-                std::size_t currentSize = oldArchetype->entityIds.size() * oldCompDataSize;
-                std::size_t newSize = currentSize - oldCompDataSize;
-                auto newData = new unsigned char[oldArchetype->componentDataSize[i] - oldCompDataSize];
-                oldArchetype->componentDataSize[i] -= oldCompDataSize;
-                for (std::size_t e = 0, ei = 0; e < oldArchetype->entityIds.size(); ++e) {
-                    if (e == record.index)
-                        continue;
+            const unsigned char* cursor = mapped->GetData() + fileArchetype.serializedOffset;
+            const unsigned char* const end = cursor + fileArchetype.serializedBytes;
 
-                    oldComp->MoveData(&oldArchetype->componentData[i][e*oldCompDataSize],
-                                      &newData[ei*oldCompDataSize]);
-                    oldComp->DestroyData(&oldArchetype->componentData[i][e*oldCompDataSize]);
+            LoadRows(archetype, entityCount,
+                     [&](std::size_t i, std::size_t first, ComponentData dst, std::size_t count,
+                         std::size_t& constructed) {
+                const std::size_t size = archetype->components[i]->GetSize();
 
-                    ++ei;
+                if (serializers[i]) {
+                    for (std::size_t row = 0; row < count; ++row) {
+                        LoadValue(*serializers[i], cursor, end, dst + row * size, constructed);
+                    }
+                    return;
                 }
 
-                delete [] oldArchetype->componentData[i];
-
-                oldArchetype->componentData[i] = newData;
-            }
-        }
-
-        void AdjustEntityArchetypes(Archetype* oldArchetype,
-                              EntityID entityId) {
-            std::vector<EntityID>::iterator entitiesToRemove
-                = std::find(oldArchetype->type.begin(),
-                            oldArchetype->type.end(),
-                            entityId);
+                // adopted columns are already in place, copied ones may span two file chunks
+                for (std::size_t row = first; row < first + count && !sameLayout;) {
+                    const std::size_t srcSlot = row % chunkCapacity;
+                    const std::size_t run = std::min(chunkCapacity - srcSlot, first + count - row);
 
-            std::for_each(entitiesToRemove, oldArchetype->entityIds.end(),
-                          [this, &oldArchetype](const EntityID& eid) {
-                Record& moveRecord = m_Entities[eid];
-                --moveRecord.index;
+                    std::memcpy(dst + (row - first) * size,
+                                data + (row / chunkCapacity) * stride + fileArchetype.columnOffsets[i] + srcSlot * size,
+                                run * size);
+                    row += run;
+                }
+                constructed += count;
             });
 
-            oldArchetype->entityIds.erase(
-                    std::remove(oldArchetype->entityIds.begin(),
-                                oldArchetype->entityIds.end(),
-                                entityId), oldArchetype->entityIds.end());
+            IndexLoadedRows(archetype);
         }
 
-        template<class C, typename... Args>
-        C* AddComponent(const EntityID& entityId, Args&&... args) {
-            ComponentTypeID newCompTypeId = Component<C>::GetTypeID();
-
-            if(!IsComponentRegistered<C>())
-            {
-                throw std::runtime_error("Component Not Registered!");
-            }
-
-            const std::size_t& compDataSize = m_ComponentMap[newCompTypeId]->GetSize();
-
-            // this ensures the entity is added to dummy archetype if needed
-            Record& record = m_Entities[entityId];
-            Archetype* oldArchetype = record.archetype;
-
-            C* newComponent = nullptr; // will be returned
+        void AllocateChunk(Archetype* archetype) {
+            Chunk chunk;
+            chunk.data = m_Allocator->Allocate(archetype->chunkBytes, archetype->chunkAlignment);
+            chunk.count = 0;
+            chunk.changedTicks.assign(archetype->type.size(), 0);
+            chunk.addedTicks.assign(archetype->type.size(), 0);
+            chunk.adopted = false;
+            archetype->chunks.push_back(std::move(chunk));
+        }
 
-            Archetype* newArchetype = nullptr;
+        // Adds chunks to a full archetype as the growth policy asks
+        void GrowChunks(Archetype* archetype) {
+            std::size_t count = std::max(m_GrowthPolicy.minChunks,
+                                         static_cast<std::size_t>(archetype->chunks.size()
+                                                                  * m_GrowthPolicy.growthFactor));
 
-            if(oldArchetype)
-            {
-                if(std::find(oldArchetype->type.begin(),
-                             oldArchetype->type.end(),
-                             newCompTypeId)
-                   != oldArchetype->type.end())
-                {
-                    // this entity already contains this component
-                    return nullptr;
-                }
+            for (std::size_t i = 0; i < std::max<std::size_t>(count, 1); ++i) {
+                AllocateChunk(archetype);
+            }
+        }
 
-                ArcheTypeID newArchetypeId = oldArchetype->type;
-                newArchetypeId.push_back(newCompTypeId);
-                std::sort(newArchetypeId.begin(), newArchetypeId.end());
+        static std::size_t GetUsedChunks(const Archetype* archetype) {
+            return (archetype->entityCount + archetype->chunkCapacity - 1) / archetype->chunkCapacity;
+        }
 
-                newArchetype = GetArchetype(newArchetypeId);
+        // Appends a row for the entity to the last used chunk, component data is left uninitialized
+        std::size_t AllocateRow(Archetype* archetype, EntityID entityId) {
+            std::size_t index = archetype->entityCount;
 
-                for(std::size_t j = 0; j < newArchetypeId.size(); ++j)
-                {
-                    const ComponentTypeID& newCompId = newArchetypeId[j];
+            if (index == archetype->chunks.size() * archetype->chunkCapacity)
+                GrowChunks(archetype);
 
-                    const ComponentBase* const newComp = m_ComponentMap[newCompId];
+            Chunk& chunk = archetype->chunks[index / archetype->chunkCapacity];
+            archetype->GetEntityIds(chunk)[chunk.count++] = entityId;
+            ++archetype->entityCount;
 
-                    const std::size_t& newCompDataSize = newComp->GetSize();
+            return index;
+        }
 
-                    std::size_t currentSize = newArchetype->entityIds.size() * newCompDataSize;
-                    std::size_t newSize = currentSize + newCompDataSize;
-                    if(newSize > newArchetype->componentDataSize[j])
-                    {
-                        newArchetype->componentDataSize[j] *= 2;
-                        newArchetype->componentDataSize[j] += newCompDataSize;
-                        unsigned char* newData = new unsigned char[newArchetype->componentDataSize[j]];
-                        for(std::size_t e = 0; e < newArchetype->entityIds.size(); ++e)
-                        {
-                            newComp->MoveData(&newArchetype->componentData[j][e*newCompDataSize],
-                                              &newData[e*newCompDataSize]);
-                            newComp->DestroyData(&newArchetype->componentData[j][e*newCompDataSize]);
-                        }
-                        delete [] newArchetype->componentData[j];
+        // Relocates row `from` into the empty row `to` and points its entity's Record there
+        void MoveRow(Archetype* archetype, std::size_t from, std::size_t to) {
+            const Chunk& srcChunk = archetype->chunks[from / archetype->chunkCapacity];
+            Chunk& dstChunk = archetype->chunks[to / archetype->chunkCapacity];
+            std::size_t srcSlot = from % archetype->chunkCapacity;
+            std::size_t dstSlot = to % archetype->chunkCapacity;
 
-                        newArchetype->componentData[j] = newData;
-                    }
+            for (std::size_t i = 0; i < archetype->type.size(); ++i) {
+                const ComponentBase* const comp = archetype->components[i];
+                const std::size_t& dataSize = comp->GetSize();
 
-                    ArcheTypeID oldArchetypeId = oldArchetype->type;
+                if (&srcChunk != &dstChunk)
+                    CarryTicks(srcChunk, i, dstChunk, i);
 
-                    for(std::size_t i = 0; i < oldArchetype->type.size(); ++i)
-                    {
-                        const ComponentTypeID& oldCompId = oldArchetype->type[i];
-                        if(oldCompId == newCompId)
-                        {
-                            const ComponentBase* const oldComp = m_ComponentMap[oldCompId];
+                if (comp->IsTag())
+                    continue;
 
-                            const std::size_t& oldCompDataSize = oldComp->GetSize();
+                comp->Relocate(&archetype->GetColumn(srcChunk, i)[srcSlot*dataSize],
+                               &archetype->GetColumn(dstChunk, i)[dstSlot*dataSize], 1);
+            }
 
-                            oldComp->MoveData(&oldArchetype->componentData[i][record.index*oldCompDataSize],
-                                              &newArchetype->componentData[j][currentSize]);
-                            oldComp->DestroyData(&oldArchetype->componentData[i][record.index*oldCompDataSize]);
+            EntityID movedId = archetype->GetEntityIds(srcChunk)[srcSlot];
+            archetype->GetEntityIds(dstChunk)[dstSlot] = movedId;
+            m_Entities[GetEntityIndex(movedId)].record.index = to;
+        }
 
-                            goto cnt;
-                        }
-                    }
+        /* Brings chunk counts in line with entityCount. Chunks left empty are released,
+         * except reserved ones and the spares the growth policy keeps. Empty adopted
+         * chunks are never kept, so a world file is unmapped once its rows are gone. */
+        void TrimChunks(Archetype* archetype) {
+            std::size_t used = GetUsedChunks(archetype);
 
-                    newComponent
-                            = new (&newArchetype->componentData[j][currentSize])
-                            C(std::forward<Args>(args)...);
+            // empty chunks sit at the end, so only the ones just emptied still carry a count
+            for (std::size_t c = used; c < archetype->chunks.size() && archetype->chunks[c].count > 0; ++c) {
+                archetype->chunks[c].count = 0;
+            }
 
-                    cnt:;
+            for (std::size_t c = archetype->chunks.size(); c > used; --c) {
+                if (archetype->chunks[c - 1].adopted) {
+                    FreeChunkData(archetype, archetype->chunks[c - 1]);
+                    archetype->chunks.erase(archetype->chunks.begin() + (c - 1));
                 }
+            }
 
-                if(!oldArchetype->entityIds.empty())
-                {
-                    for(std::size_t i = 0; i < oldArchetype->type.size(); ++i)
-                    {
-                        const ComponentTypeID& oldCompTypeID = oldArchetype->type[i];
+            std::size_t keep = std::max(used + m_GrowthPolicy.spareChunks, archetype->reservedChunks);
+            while (archetype->chunks.size() > keep) {
+                FreeChunkData(archetype, archetype->chunks.back());
+                archetype->chunks.pop_back();
+            }
 
-                        if(oldCompTypeID == newCompTypeId)
-                        {
-                            ComponentBase* removeWrapper = m_ComponentMap[newCompTypeId];
-                            removeWrapper->DestroyData(
-                                    &oldArchetype->componentData[i][record.index*sizeof(C)]);
-                        }
+            if (used > 0) {
+                archetype->chunks[used - 1].count =
+                        archetype->entityCount - (used - 1) * archetype->chunkCapacity;
+            }
+        }
 
-                        const ComponentBase* const oldComp = m_ComponentMap[oldCompTypeID];
+        /* Releases a row whose component data has already been moved out or destroyed.
+         * The archetype's last row is moved into the hole, so only one Record changes. */
+        void FreeRow(Archetype* archetype, std::size_t index) {
+            std::size_t last = --archetype->entityCount;
 
-                        const std::size_t& oldCompDataSize = oldComp->GetSize();
+            if (index != last)
+                MoveRow(archetype, last, index);
 
-                        std::size_t currentSize = oldArchetype->entityIds.size() * oldCompDataSize;
-                        std::size_t newSize = currentSize - oldCompDataSize;
-                        unsigned char* newData = new unsigned char[oldArchetype->componentDataSize[i]-oldCompDataSize];
-                        oldArchetype->componentDataSize[i] -= oldCompDataSize;
-                        for(std::size_t e = 0, ei = 0; e < oldArchetype->entityIds.size(); ++e)
-                        {
-                            if(e == record.index)
-                                continue;
+            TrimChunks(archetype);
+        }
 
-                            oldComp->MoveData(&oldArchetype->componentData[i][e*oldCompDataSize],
-                                              &newData[ei*oldCompDataSize]);
-                            oldComp->DestroyData(&oldArchetype->componentData[i][e*oldCompDataSize]);
+        /* Releases many emptied rows of one archetype at once. Rows must be sorted in
+         * descending order so the row pulled in from the tail is never one that is
+         * itself being removed; every surviving row moves at most once. */
+        void FreeRows(Archetype* archetype, const std::vector<std::size_t>& rows) {
+            for (const std::size_t& index : rows) {
+                std::size_t last = --archetype->entityCount;
 
-                            ++ei;
-                        }
+                if (index != last)
+                    MoveRow(archetype, last, index);
+            }
 
-                        delete [] oldArchetype->componentData[i];
+            TrimChunks(archetype);
+        }
 
-                        oldArchetype->componentData[i] = newData;
-                    }
-                }
+        /* Moves an entity into newArchetype, carrying over every component both archetypes
+         * share and destroying the ones newArchetype lacks. Columns only newArchetype has
+         * are left for the caller to construct. */
+        void MoveEntity(const EntityID& entityId, Record& record, Archetype* newArchetype) {
+            Archetype* oldArchetype = record.archetype;
+            std::size_t newIndex = AllocateRow(newArchetype, entityId);
 
-                std::vector<EntityID>::iterator willBeRemoved
-                        = std::find(oldArchetype->entityIds.begin(),
-                                    oldArchetype->entityIds.end(),
-                                    entityId);
+            if (oldArchetype) {
+                const Chunk& oldChunk = oldArchetype->chunks[record.index / oldArchetype->chunkCapacity];
+                Chunk& newChunk = newArchetype->chunks[newIndex / newArchetype->chunkCapacity];
 
-                std::for_each(willBeRemoved, oldArchetype->entityIds.end(),
-                              [this,&oldArchetype](const EntityID& eid)
-                              {
-                                  Record& moveR = m_Entities[eid];
-                                  --moveR.index;
-                              });
+                std::size_t j = 0;
+                for (std::size_t i = 0; i < oldArchetype->type.size(); ++i) {
+                    const ComponentBase* const oldComp = oldArchetype->components[i];
 
-                oldArchetype->entityIds.erase(willBeRemoved);
-            }
-            else
-            {
-                ArcheTypeID newArchetypeId(1, newCompTypeId);
+                    while (j < newArchetype->type.size() && newArchetype->type[j] < oldArchetype->type[i]) {
+                        ++j;
+                    }
 
-                const ComponentBase* const newComp = m_ComponentMap[newCompTypeId];
+                    bool carried = j < newArchetype->type.size() && newArchetype->type[j] == oldArchetype->type[i];
+                    if (carried)
+                        CarryTicks(oldChunk, i, newChunk, j);
 
-                newArchetype = GetArchetype(newArchetypeId);
+                    if (oldComp->IsTag())
+                        continue;
 
-                std::size_t currentSize = newArchetype->entityIds.size() * compDataSize;
-                std::size_t newSize = currentSize + compDataSize;
-                if(newSize > newArchetype->componentDataSize[0])
-                {
-                    newArchetype->componentDataSize[0] *= 2;
-                    newArchetype->componentDataSize[0] += compDataSize;
-                    unsigned char* newData = new unsigned char[newArchetype->componentDataSize[0]];
-                    for(std::size_t e = 0; e < newArchetype->entityIds.size(); ++e)
-                    {
-                        newComp->MoveData(&newArchetype->componentData[0][e*compDataSize],
-                                          &newData[e*compDataSize]);
-                        newComp->DestroyData(&newArchetype->componentData[0][e*compDataSize]);
-                    }
-                    delete [] (newArchetype->componentData[0]);
+                    ComponentData oldData = GetComponentData(oldArchetype, i, record.index);
 
-                    newArchetype->componentData[0] = newData;
+                    if (carried)
+                        oldComp->Relocate(oldData, GetComponentData(newArchetype, j, newIndex), 1);
+                    else
+                        oldComp->Destroy(oldData, 1);
                 }
 
-                newComponent
-                        = new (&newArchetype->componentData[0][currentSize])
-                        C(std::forward<Args>(args)...);
+                FreeRow(oldArchetype, record.index);
             }
 
-            newArchetype->entityIds.push_back(entityId);
-            record.index = newArchetype->entityIds.size()-1;
+            record.index = newIndex;
             record.archetype = newArchetype;
-
-            return newComponent;
         }
 
-        template<class C>
-        void RemoveComponent(const EntityID& entityId) {
-            if (!IsComponentRegistered<C>()) {
-                return;
-            }
+    private:
+        std::shared_ptr<ChunkAllocator> m_Allocator;
 
-            ComponentTypeID compTypeId = Component<C>::GetTypeID();
+        EntitySlotArray m_Entities;
 
-            if (!m_Entities.contains(entityId)) {
-                return;
-            }
+        ArchetypesArray m_Archetypes;
 
-            Record& record = m_Entities[entityId];
-            Archetype* oldArchetype = record.archetype;
+        ArchetypeIndexMap m_ArchetypeIndex;
 
-            if (!oldArchetype) {
-                return;
-            }
+        Archetype* m_EmptyArchetype;
 
-            if (std::find(oldArchetype->type.begin(),
-                          oldArchetype->type.end(),
-                          compTypeId) == oldArchetype->type.end()) {
-                return;
-            }
+        std::uint32_t m_FreeSlot;
 
-            ArcheTypeID newArchetypeId = oldArchetype->type;
-            newArchetypeId.erase(std::remove(newArchetypeId.begin(),
-                                             newArchetypeId.end(),
-                                             compTypeId),
-                                 newArchetypeId.end());
+        // Slots handed out by ReserveID past the end of m_Entities, not appended yet
+        std::uint32_t m_ReservedSlots;
+        std::mutex m_ReserveMutex;
 
-            std::sort(newArchetypeId.begin(), newArchetypeId.end());
+        GrowthPolicy m_GrowthPolicy;
 
-            Archetype* newArchetype = GetArchetype(newArchetypeId);
+        std::atomic<ChangeTick> m_ChangeTick;
 
-            PrepareCompData(newArchetypeId, newArchetype, oldArchetype, record);
+        SystemsArrayMap m_Systems;
 
-            RemoveTargetComponent<C>(oldArchetype, compTypeId, record);
+        QueryMap m_Queries;
 
-            AdjustEntityArchetypes(oldArchetype, entityId);
 
-            newArchetype->entityIds.push_back(entityId);
-            record.index = newArchetype->entityIds.size() - 1;
-            record.archetype = newArchetype;
-        }
+        ComponentTypeIDBaseMap m_ComponentMap;
+        // The same components indexed by Component<C>::GetTypeIndex
+        std::vector<ComponentBase*> m_ComponentsByIndex;
 
-    private:
-        EntityArchetypeMap m_Entities;
+        ComponentSerializerMap m_Serializers;
 
-        ArchetypesArray m_Archetypes;
+        ComponentBufferMap m_ComponentBuffers;
 
-        EntityID m_EntityIdCounter;
+        // Mappings of loaded world files that still have adopted chunks
+        std::vector<WorldFile> m_WorldFiles;
 
-        SystemsArrayMap m_Systems;
+        std::vector<std::shared_ptr<void>> m_Resources;
 
-        ComponentTypeIDBaseMap m_ComponentMap;
+        CommandBuffer m_Commands;
     };
 
+    inline EntityID CommandBuffer::CreateEntity() {
+        return m_Ecs.ReserveID();
+    }
+
     template<class... Ts>
     ArcheTypeID SortKeys(ArcheTypeID types) {
         ENG_CORE_INFO("SORTING THE KEY");
@@ -497,38 +2282,88 @@ namespace Engine {
 
         friend class ECS;
 
-        typedef std::function<void(const float,const std::vector<EntityID>&,Cs*...)> Func;
+        typedef typename SystemFunc<decltype(std::tuple_cat(std::declval<SystemArgs<Cs>>()...))>::Type
+                Func;
 
         System(ECS& ecs, const std::uint8_t& layer);
 
         virtual ArcheTypeID GetKey() const override;
 
+        virtual ArcheTypeID GetExcludes() const override;
+
+        virtual ArcheTypeID GetOptionals() const override;
+
+        virtual ArcheTypeID GetReads() const override;
+
+        virtual ArcheTypeID GetWrites() const override;
+
         void Action(Func func);
 
+        // Per-entity form of Action: fn(elapsed, entityId, EntityArg<Cs>...) for every row
+        template<class Fn>
+        void ForEach(Fn fn);
+
+        /* Splits each matching archetype into row ranges of at least minBatchSize and
+         * runs func on them through the JobSystem (ranges never span chunks). Func must then be
+         * safe to call from several threads at once. 0 runs the system on one thread. */
+        void SetParallel(const std::size_t minBatchSize);
+
     protected:
 
-        template<std::size_t Index1, typename T, typename... Ts>
+        /* Id a parameter is scheduled by. Resources get the type id of Res<T>, which never
+         * names a component, to keep both in one sorted access set. */
+        template<class T>
+        static ComponentTypeID GetAccessID();
+
+        // Whether chunk has the changes the Changed/Added parameters ask for
+        bool IsChunkSelected(const Chunk& chunk, const std::size_t* columns) const;
+
+        // Stamps the columns the system gets mutable access to as changed in chunk
+        void MarkWritten(Chunk& chunk, const std::size_t* columns) const;
+
+        // Runs f over the archetype's selected chunks, in batches when the system is parallel
+        template<class F>
+        void Iterate(const float elapsedMilliseconds,
+                     Archetype* archetype,
+                     const std::size_t* columns,
+                     F& f);
+
+        template<std::size_t Index1, class F, typename... Ts>
         std::enable_if_t<Index1==sizeof...(Cs)>
-        DoAction(const float elapsedMilliseconds,
-                 const ArcheTypeID& archeTypeIds,
-                 const std::vector<EntityID>& entityIDs,
-                 T& t,
+        DoAction(F& f,
+                 const float elapsedMilliseconds,
+                 const Archetype* archetype,
+                 const Chunk& chunk,
+                 const std::size_t* columns,
+                 const std::size_t first,
+                 const std::size_t count,
                  Ts... ts);
 
-        template<std::size_t Index1, typename T, typename... Ts>
+        template<std::size_t Index1, class F, typename... Ts>
         std::enable_if_t<Index1 != sizeof...(Cs)>
-        DoAction(const float elapsedMilliseconds,
-                 const ArcheTypeID& archeTypeIds,
-                 const std::vector<EntityID>& entityIDs,
-                 T& t,
+        DoAction(F& f,
+                 const float elapsedMilliseconds,
+                 const Archetype* archetype,
+                 const Chunk& chunk,
+                 const std::size_t* columns,
+                 const std::size_t first,
+                 const std::size_t count,
                  Ts... ts);
 
         virtual void DoAction(const float elapsedMilliseconds,
-                              Archetype* archetype) override;
+                              Archetype* archetype,
+                              const std::size_t* columns) override;
 
         ECS& m_ecs;
         Func m_func;
         bool m_funcSet;
+        std::size_t m_minBatchSize;
+
+        // Where each parameter's column sits in the query's resolved columns, if it has one
+        std::array<std::size_t, sizeof...(Cs)> m_columnSlots;
+
+        // Resource type id of each Res<T> parameter, resolved here rather than on workers
+        std::array<IDType, sizeof...(Cs)> m_resourceIds;
     };
 
     template<class... Cs>
@@ -538,12 +2373,48 @@ namespace Engine {
         m_funcSet = true;
     }
 
+    template<class... Cs>
+    template<class Fn>
+    void System<Cs...>::ForEach(Fn fn)
+    {
+        typedef decltype(std::tuple_cat(std::declval<SystemTerms<Cs>>()...)) Terms;
+        Action(ForEachAdapter<Fn, Terms>{fn});
+    }
+
+    template<class... Cs>
+    void System<Cs...>::SetParallel(const std::size_t minBatchSize)
+    {
+        m_minBatchSize = minBatchSize;
+    }
+
     template<class... Cs>
     System<Cs...>::System(ECS& ecs, const std::uint8_t& layer)
             :
             m_ecs(ecs),
-            m_funcSet(false)
+            m_funcSet(false),
+            m_minBatchSize(0)
     {
+        // same order the ECS resolves a query's columns in
+        const ArcheTypeID key = GetKey();
+        const ArcheTypeID optional = GetOptionals();
+        ArcheTypeID columnIds;
+        std::set_union(key.begin(), key.end(), optional.begin(), optional.end(),
+                       std::back_inserter(columnIds));
+
+        std::size_t i = 0;
+        ([&]()
+        {
+            ArcheTypeID::const_iterator slot = std::find(columnIds.begin(), columnIds.end(), GetAccessID<Cs>());
+            m_columnSlots[i] = slot - columnIds.begin();
+
+            if constexpr(SystemParam<Cs>::isResource)
+                m_resourceIds[i] = ECS::GetResourceTypeID<typename SystemParam<Cs>::Value>();
+            else
+                m_resourceIds[i] = -1;
+
+            ++i;
+        }(), ...);
+
         m_ecs.RegisterSystem(layer, std::shared_ptr<SystemBase>(this));
     }
 
@@ -554,64 +2425,296 @@ namespace Engine {
         return types;
     }
 
+    template<class... Cs>
+    template<class T>
+    ComponentTypeID System<Cs...>::GetAccessID()
+    {
+        typedef std::remove_const_t<typename SystemParam<T>::Value> Value;
+
+        if constexpr(SystemParam<T>::isResource)
+            return ComponentTypeHash<Res<Value>>::value;
+        else
+            return Component<Value>::GetTypeID();
+    }
+
+    template<class... Cs>
+    bool System<Cs...>::IsChunkSelected(const Chunk& chunk, const std::size_t* columns) const
+    {
+        bool selected = true;
+        std::size_t i = 0;
+        ([&]()
+        {
+            typedef SystemParam<Cs> Param;
+            if constexpr(Param::changedOnly || Param::addedOnly)
+            {
+                const std::size_t column = columns[m_columnSlots[i]];
+                const ChangeTick tick = Param::addedOnly ? chunk.addedTicks[column]
+                                                         : chunk.changedTicks[column];
+                selected = selected && IsNewerTick(tick, m_LastRunTick);
+            }
+            ++i;
+        }(), ...);
+        return selected;
+    }
+
+    template<class... Cs>
+    void System<Cs...>::MarkWritten(Chunk& chunk, const std::size_t* columns) const
+    {
+        std::size_t i = 0;
+        ([&]()
+        {
+            typedef SystemParam<Cs> Param;
+            if constexpr(Param::hasAccess && !Param::isResource && !std::is_const_v<typename Param::Value>)
+            {
+                const std::size_t column = columns[m_columnSlots[i]];
+                if(column != Query::MISSING_COLUMN)
+                    chunk.changedTicks[column] = m_RunTick;
+            }
+            ++i;
+        }(), ...);
+    }
+
     template<class... Cs>
     ArcheTypeID System<Cs...>::GetKey() const
     {
-        return sort_keys({{Component<Cs>::GetTypeID()...}});
+        ArcheTypeID key;
+        ([&]()
+        {
+            if constexpr(SystemParam<Cs>::isRequired)
+                key.push_back(GetAccessID<Cs>());
+        }(), ...);
+        return sort_keys(key);
+    }
+
+    template<class... Cs>
+    ArcheTypeID System<Cs...>::GetExcludes() const
+    {
+        ArcheTypeID excludes;
+        ([&]()
+        {
+            if constexpr(SystemParam<Cs>::isExcluded)
+                excludes.push_back(GetAccessID<Cs>());
+        }(), ...);
+        return sort_keys(excludes);
+    }
+
+    template<class... Cs>
+    ArcheTypeID System<Cs...>::GetOptionals() const
+    {
+        ArcheTypeID optionals;
+        ([&]()
+        {
+            typedef SystemParam<Cs> Param;
+            if constexpr(Param::hasAccess && !Param::isRequired && !Param::isResource)
+                optionals.push_back(GetAccessID<Cs>());
+        }(), ...);
+        return sort_keys(optionals);
+    }
+
+    // Parameters requested as const, e.g. System<const Position, Velocity>, are only read
+    template<class... Cs>
+    ArcheTypeID System<Cs...>::GetReads() const
+    {
+        ArcheTypeID reads;
+        ([&]()
+        {
+            if constexpr(SystemParam<Cs>::hasAccess && std::is_const_v<typename SystemParam<Cs>::Value>)
+                reads.push_back(GetAccessID<Cs>());
+        }(), ...);
+        return sort_keys(reads);
+    }
+
+    template<class... Cs>
+    ArcheTypeID System<Cs...>::GetWrites() const
+    {
+        ArcheTypeID writes;
+        ([&]()
+        {
+            if constexpr(SystemParam<Cs>::hasAccess && !std::is_const_v<typename SystemParam<Cs>::Value>)
+                writes.push_back(GetAccessID<Cs>());
+        }(), ...);
+        return sort_keys(writes);
     }
 
     template<class... Cs>
-    void System<Cs...>::DoAction(const float elapsedMilliseconds, Archetype* archetype)
+    void System<Cs...>::DoAction(const float elapsedMilliseconds,
+                                 Archetype* archetype,
+                                 const std::size_t* columns)
     {
         if(m_funcSet)
-            DoAction<0>(elapsedMilliseconds,
-                        archetype->type,
-                        archetype->entityIds,
-                        archetype->componentData);
+            Iterate(elapsedMilliseconds, archetype, columns, m_func);
+    }
+
+    template<class... Cs>
+    template<class F>
+    void System<Cs...>::Iterate(const float elapsedMilliseconds,
+                                Archetype* archetype,
+                                const std::size_t* columns,
+                                F& f)
+    {
+        if(m_minBatchSize == 0 || archetype->entityCount <= m_minBatchSize)
+        {
+            for(Chunk& chunk : archetype->chunks)
+            {
+                if(chunk.count > 0 && IsChunkSelected(chunk, columns))
+                {
+                    MarkWritten(chunk, columns);
+                    DoAction<0>(f, elapsedMilliseconds, archetype, chunk, columns, 0, chunk.count);
+                }
+            }
+            return;
+        }
+
+        // ticks are settled up front so batches of one chunk never race on them
+        const std::size_t usedChunks = (archetype->entityCount + archetype->chunkCapacity - 1)
+                                       / archetype->chunkCapacity;
+        std::vector<std::size_t> chunks;
+        for(std::size_t c = 0; c < usedChunks; ++c)
+        {
+            if(IsChunkSelected(archetype->chunks[c], columns))
+            {
+                MarkWritten(archetype->chunks[c], columns);
+                chunks.push_back(c);
+            }
+        }
+
+        // every chunk but the last is full, so batch b maps straight to a chunk and offset
+        const std::size_t batchSize = std::min(m_minBatchSize, archetype->chunkCapacity);
+        const std::size_t batchesPerChunk = (archetype->chunkCapacity + batchSize - 1) / batchSize;
+
+        JobSystem::ParallelFor(chunks.size() * batchesPerChunk, [&](std::size_t b)
+        {
+            const Chunk& chunk = archetype->chunks[chunks[b / batchesPerChunk]];
+            const std::size_t first = (b % batchesPerChunk) * batchSize;
+
+            if(first < chunk.count)
+                DoAction<0>(f, elapsedMilliseconds, archetype, chunk, columns,
+                            first, std::min(batchSize, chunk.count - first));
+        });
     }
 
     template<class... Cs>
-    template<std::size_t Index, typename T, typename... Ts>
+    template<std::size_t Index, class F, typename... Ts>
     std::enable_if_t<Index != sizeof...(Cs)>
-    System<Cs...>::DoAction(const float elapsedMilliseconds,
-                            const ArcheTypeID& archeTypeIds,
-                            const std::vector<EntityID>& entityIDs,
-                            T& t,
+    System<Cs...>::DoAction(F& f,
+                            const float elapsedMilliseconds,
+                            const Archetype* archetype,
+                            const Chunk& chunk,
+                            const std::size_t* columns,
+                            const std::size_t first,
+                            const std::size_t count,
                             Ts... ts)
     {
-        using IthT = typename std::tuple_element<Index, std::tuple<Cs...>>::type;
-        std::size_t index2 = 0;
-        ComponentTypeID thisTypeCS = Component<IthT>::GetTypeID();
-        ComponentTypeID thisArchetypeID = archeTypeIds[index2];
-        while(thisTypeCS != thisArchetypeID && index2 < archeTypeIds.size())
+        typedef SystemParam<typename std::tuple_element<Index, std::tuple<Cs...>>::type> Param;
+        using IthT = typename Param::Value;
+
+        if constexpr(!Param::hasAccess)
         {
-            ++index2;
-            thisArchetypeID = archeTypeIds[index2];
+            DoAction<Index+1>(f,
+                              elapsedMilliseconds,
+                              archetype,
+                              chunk,
+                              columns,
+                              first,
+                              count,
+                              ts...);
         }
-        if(index2 == archeTypeIds.size())
+        else if constexpr(Param::isResource)
         {
-            throw std::runtime_error
-                    ("System was executed against an incorrect Archetype");
+            DoAction<Index+1>(f,
+                              elapsedMilliseconds,
+                              archetype,
+                              chunk,
+                              columns,
+                              first,
+                              count,
+                              ts...,
+                              m_ecs.template Resource<IthT>(m_resourceIds[Index]));
         }
+        else
+        {
+            // resolved when the archetype joined the query, missing only for Optional<T>
+            const std::size_t column = columns[m_columnSlots[Index]];
 
-        DoAction<Index+1>(elapsedMilliseconds,
-                          archeTypeIds,
-                          entityIDs,
-                          t,
-                          ts...,
-                          reinterpret_cast<IthT*>(&t[index2][0]));
+            // tags have no column, so presence is all a tag's pointer tells
+            IthT* data = nullptr;
+            if(column != Query::MISSING_COLUMN)
+            {
+                if constexpr(IsTagComponent<std::remove_const_t<IthT>>::value)
+                    data = GetTagInstance<std::remove_const_t<IthT>>();
+                else
+                    data = reinterpret_cast<IthT*>(archetype->GetColumn(chunk, column)) + first;
+            }
+
+            DoAction<Index+1>(f,
+                              elapsedMilliseconds,
+                              archetype,
+                              chunk,
+                              columns,
+                              first,
+                              count,
+                              ts...,
+                              data);
+        }
     }
 
     template<class... Cs>
-    template<std::size_t Index, typename T, typename... Ts>
+    template<std::size_t Index, class F, typename... Ts>
     std::enable_if_t<Index==sizeof...(Cs)>
-    System<Cs...>::DoAction(const float elapsedMilliseconds,
-                            const ArcheTypeID& archeTypeIds,
-                            const std::vector<EntityID>& entityIDs,
-                            T& t,
+    System<Cs...>::DoAction(F& f,
+                            const float elapsedMilliseconds,
+                            const Archetype* archetype,
+                            const Chunk& chunk,
+                            const std::size_t* /*columns*/,
+                            const std::size_t first,
+                            const std::size_t count,
                             Ts... ts)
     {
-        m_func(elapsedMilliseconds, entityIDs, ts...);
+        f(elapsedMilliseconds,
+          std::span<const EntityID>(archetype->GetEntityIds(chunk) + first, count),
+          ts...);
+    }
+
+    /* A System whose callable type is part of the system type, so it is called without
+     * type erasure and can be inlined into the chunk loop. Create it with MakeSystem or
+     * MakeForEachSystem. */
+    template<class Fn, class... Cs>
+    class StaticSystem : public System<Cs...>
+    {
+    public:
+
+        StaticSystem(ECS& ecs, const std::uint8_t& layer, Fn fn)
+                :
+                System<Cs...>(ecs, layer),
+                m_fn(std::move(fn))
+        {
+        }
+
+    protected:
+
+        virtual void DoAction(const float elapsedMilliseconds,
+                              Archetype* archetype,
+                              const std::size_t* columns) override
+        {
+            this->Iterate(elapsedMilliseconds, archetype, columns, m_fn);
+        }
+
+        Fn m_fn;
+    };
+
+    // fn(elapsed, entities, columns...) is called per chunk like a System's Action
+    template<class... Cs, class Fn>
+    StaticSystem<Fn, Cs...>* MakeSystem(ECS& ecs, const std::uint8_t& layer, Fn fn)
+    {
+        return new StaticSystem<Fn, Cs...>(ecs, layer, std::move(fn));
+    }
+
+    // fn(elapsed, entityId, EntityArg<Cs>...) is called per entity
+    template<class... Cs, class Fn>
+    auto MakeForEachSystem(ECS& ecs, const std::uint8_t& layer, Fn fn)
+    {
+        typedef ForEachAdapter<Fn, decltype(std::tuple_cat(std::declval<SystemTerms<Cs>>()...))> Adapter;
+        return new StaticSystem<Adapter, Cs...>(ecs, layer, Adapter{std::move(fn)});
     }
 
 }
@@ -1,31 +1,141 @@
 #ifndef GRAPHICSTEMPLATE_ECSTYPES_H
 #define GRAPHICSTEMPLATE_ECSTYPES_H
 
+#include <atomic>
 #include <cstdlib>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include "TypeHash.h"
 
 namespace Engine {
 
+    class ComponentBase;
+
     typedef std::int32_t IDType;
-    typedef IDType EntityID;
-    typedef IDType ComponentTypeID;
+    // Stable across runs, processes and modules; see ComponentTypeHash
+    typedef TypeHash ComponentTypeID;
     typedef std::vector<ComponentTypeID> ArcheTypeID;
     typedef unsigned char* ComponentData;
 
-    const IDType NULL_ENTITY = 0;
+    // Entity handles pack a slot index (low 32 bits) and that slot's version (high 32 bits)
+    typedef std::uint64_t EntityID;
+
+    const EntityID NULL_ENTITY = 0;
+
+    inline std::uint32_t GetEntityIndex(EntityID entityId) {
+        return static_cast<std::uint32_t>(entityId);
+    }
+
+    inline std::uint32_t GetEntityVersion(EntityID entityId) {
+        return static_cast<std::uint32_t>(entityId >> 32);
+    }
+
+    inline EntityID MakeEntityID(std::uint32_t index, std::uint32_t version) {
+        return (static_cast<EntityID>(version) << 32) | index;
+    }
+
+    /* Change ticks order writes against system runs. They wrap around, so compare them
+     * with IsNewerTick rather than operator>. */
+    typedef std::uint32_t ChangeTick;
+
+    inline bool IsNewerTick(ChangeTick tick, ChangeTick since) {
+        return static_cast<std::int32_t>(tick - since) > 0;
+    }
+
+    // Every archetype stores its entities in fixed-size blocks of this many bytes
+    const std::size_t CHUNK_SIZE = 16 * 1024;
+
+    /* Minimum alignment of every component column (and of each chunk). The default of
+     * one cache line lets vectorized systems use aligned loads on any column. */
+#ifndef ENG_ECS_COLUMN_ALIGNMENT
+#define ENG_ECS_COLUMN_ALIGNMENT 64
+#endif
+
+    const std::size_t COLUMN_ALIGNMENT = ENG_ECS_COLUMN_ALIGNMENT;
+
+    /* A chunk holds the entity ids followed by one column per component (SoA) for
+     * up to Archetype::chunkCapacity entities. Chunks are kept full except the last
+     * used one, so row i of an archetype lives in chunk i / chunkCapacity. Empty spare
+     * chunks may follow the used ones. Change ticks are tracked per chunk, not per row. */
+    struct Chunk {
+        ComponentData data;
+        std::size_t count;
+
+        // Per column: the last tick a system wrote it, and the last tick it received new values
+        std::vector<ChangeTick> changedTicks;
+        std::vector<ChangeTick> addedTicks;
+
+        // Points into a loaded world file rather than allocator memory
+        bool adopted;
+    };
+
+    struct ArcheTypeIDHash {
+        std::size_t operator()(const ArcheTypeID& id) const {
+            std::size_t hash = id.size();
+            for (const ComponentTypeID& compId : id) {
+                hash ^= static_cast<std::size_t>(compId) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            }
+            return hash;
+        }
+    };
+
+    struct Archetype;
+
+    typedef std::unordered_map<ComponentTypeID, Archetype*> ArchetypeEdgeMap;
 
     struct Archetype {
         ArcheTypeID type;
-        std::vector<ComponentData> componentData;
-        std::vector<EntityID> entityIds;
-        std::vector<std::size_t> componentDataSize;
+        std::vector<const ComponentBase*> components;
+        std::vector<std::size_t> columnOffsets;
+        std::vector<Chunk> chunks;
+        std::size_t chunkCapacity;
+        std::size_t chunkBytes;
+        std::size_t chunkAlignment;
+        std::size_t entityCount;
+        // Chunks pinned by ECS::Reserve, kept even while empty
+        std::size_t reservedChunks;
+
+        // Cached transitions: "this archetype plus/minus component C"
+        ArchetypeEdgeMap addEdges;
+        ArchetypeEdgeMap removeEdges;
+
+        EntityID* GetEntityIds(const Chunk& chunk) const {
+            return reinterpret_cast<EntityID*>(chunk.data);
+        }
+
+        ComponentData GetColumn(const Chunk& chunk, std::size_t column) const {
+            return chunk.data + columnOffsets[column];
+        }
+    };
+
+    /* A persistent "has all of key and none of exclude" match. The ECS keeps archetypes
+     * up to date as they are created, so iterating a query never re-tests archetypes. */
+    struct Query {
+        static constexpr std::size_t MISSING_COLUMN = SIZE_MAX;
+
+        ArcheTypeID key;
+        ArcheTypeID exclude;
+        // Components whose columns are resolved for every archetype: key plus optional ones
+        ArcheTypeID columnIds;
+        std::vector<Archetype*> archetypes;
+        // Row a holds the column of each of columnIds in archetypes[a], or MISSING_COLUMN
+        std::vector<std::size_t> columns;
+
+        const std::size_t* GetColumns(std::size_t archetype) const {
+            return columns.data() + archetype * columnIds.size();
+        }
     };
 
+    /* Hands out dense ids 0, 1, 2... per family T in first-use order. They are only
+     * meaningful within one process, so use them to index arrays, never to persist. */
     template<class T>
     class TypeIdGenerator {
     private:
-        static IDType m_Count;
+        // ids of different types can be handed out on several threads at once
+        static std::atomic<IDType> m_Count;
     public:
         template<class U>
         static const IDType GetNewID() {
@@ -34,7 +144,7 @@ namespace Engine {
         }
     };
 
-    template<class T> IDType TypeIdGenerator<T>::m_Count = 0;
+    template<class T> std::atomic<IDType> TypeIdGenerator<T>::m_Count(0);
 
 }
 
@@ -25,6 +25,10 @@ namespace Engine {
             return m_Ecs.AddComponent<C>(m_Id, std::forward<C>(c));
         }
 
+        void Destroy() {
+            m_Ecs.DestroyEntity(m_Id);
+        }
+
         EntityID GetID() const {
             return m_Id;
         }
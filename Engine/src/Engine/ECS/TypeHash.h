@@ -0,0 +1,45 @@
+#ifndef GRAPHICSTEMPLATE_TYPEHASH_H
+#define GRAPHICSTEMPLATE_TYPEHASH_H
+
+#include <cstdint>
+#include <string_view>
+
+namespace Engine {
+
+    typedef std::uint64_t TypeHash;
+
+    constexpr TypeHash HashFNV1a(std::string_view text) {
+        TypeHash hash = 14695981039346656037ull;
+        for (char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /* The compiler's spelling of T, taken from the signature of this function. It is the
+     * same in every build made with one compiler, but differs between compilers. */
+    template<class T>
+    constexpr std::string_view GetTypeName() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        std::string_view name = __FUNCSIG__;
+        name = name.substr(name.find("GetTypeName<") + 12);
+        return name.substr(0, name.rfind(">(void)"));
+#else
+        // "... [with T = Name; ...]" (GCC) or "... [T = Name]" (Clang)
+        std::string_view name = __PRETTY_FUNCTION__;
+        name = name.substr(name.find("T = ") + 4);
+        std::size_t end = name.find(';');
+        return name.substr(0, end != std::string_view::npos ? end : name.rfind(']'));
+#endif
+    }
+
+    // Stable across runs and modules, unlike the ids of TypeIdGenerator
+    template<class T>
+    constexpr TypeHash GetTypeHash() {
+        return HashFNV1a(GetTypeName<T>());
+    }
+
+}
+
+#endif //GRAPHICSTEMPLATE_TYPEHASH_H
@@ -23,9 +23,9 @@ struct Randomness {
 class PhysicsSystem {
 public:
     static void Update(const float elapsedMilliseconds,
-                       const std::vector<Engine::EntityID>& entities,
+                       std::span<const Engine::EntityID> entities,
                        Position* p,
-                       Velocity* v) {
+                       const Velocity* v) {
 
         if (Engine::Input::IsKeyPressed(GLFW_KEY_W)) {
             for(std::size_t i = 0; i < entities.size(); ++i)
@@ -59,7 +59,7 @@ public:
         barrier.Add<Position>({1, 1});
         player.Add<Randomness>({0.8f});
 
-        movementSystem = new Engine::System<Position, Velocity>(ecs, 0);
+        movementSystem = new Engine::System<Position, const Velocity>(ecs, 0);
         movementSystem->Action(PhysicsSystem::Update);
     }
 
@@ -68,7 +68,7 @@ public:
     }
 
 private:
-    Engine::System<Position, Velocity>* movementSystem;
+    Engine::System<Position, const Velocity>* movementSystem;
 };
 
 Engine::Application* Engine::CreateApplication() {